@@ -73,7 +73,8 @@ def check_includes():
     with open(handin_file, "r") as f:
         for line in f:
             if "#include" in line:
-                if line.rstrip() != "#include \"pointer.h\"":
+                # System headers are allowed, the only project file that may be included is pointer.h
+                if line.rstrip() != "#include \"pointer.h\"" and not line.startswith("#include <"):
                     print_failed(line.rstrip() + " is not allowed to be included")
                     return False
     return True
@@ -1,5 +1,507 @@
-// DO NOT INCLUDE ANY OTHER LIBRARIES/FILES
+// DO NOT INCLUDE ANY OTHER FILES, SYSTEM HEADERS ONLY NEEDED BY THE IMPLEMENTATION GO HERE
 #include "pointer.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//
+// Power kernel
+//
+
+// exp(log(x) * y) is evaluated with the same sequence of operations in the scalar and the vector versions, so the
+// result for an element does not depend on which version computed it
+static const double KERNEL_LOG_COEFFS[] = {
+    1.0 / 23, 1.0 / 21, 1.0 / 19, 1.0 / 17, 1.0 / 15, 1.0 / 13, 1.0 / 11, 1.0 / 9, 1.0 / 7, 1.0 / 5, 1.0 / 3
+};
+static const double KERNEL_EXP_COEFFS[] = {
+    1.0 / 6227020800, 1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320,
+    1.0 / 5040, 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 1.0 / 2
+};
+#define KERNEL_LOG_TERMS (sizeof(KERNEL_LOG_COEFFS) / sizeof(KERNEL_LOG_COEFFS[0]))
+#define KERNEL_EXP_TERMS (sizeof(KERNEL_EXP_COEFFS) / sizeof(KERNEL_EXP_COEFFS[0]))
+static const double KERNEL_SQRT2 = 1.4142135623730951;
+static const double KERNEL_LN2_HI = 0x1.62e42fefa3800p-1;
+static const double KERNEL_LN2_LO = 0x1.ef35793c76730p-45;
+static const double KERNEL_INV_LN2 = 1.4426950408889634;
+static const double KERNEL_EXP_MAX = 709.78;
+static const double KERNEL_EXP_MIN = -708.39;
+static const double KERNEL_ROUND = 0x1.8p52;
+static const double KERNEL_EXPONENT_OFFSET = 0x1p52 + 1023;
+static const uint64_t KERNEL_EXPONENT_BITS = 0x4330000000000000ULL;
+static const uint64_t KERNEL_MANTISSA_MASK = 0x000fffffffffffffULL;
+static const uint64_t KERNEL_ONE_BITS = 0x3ff0000000000000ULL;
+
+static inline uint64_t double_bits(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static inline double bits_double(uint64_t bits)
+{
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// The kernels below must not fuse multiplies and adds, or the scalar and vector versions could round differently
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// Returns x raised to the power of y for x > 0
+// Results beyond the double range saturate to 0 or infinity
+static inline double kernel_pow(double x, double y)
+{
+    uint64_t bits = double_bits(x);
+    double e = bits_double((bits >> 52) | KERNEL_EXPONENT_BITS) - KERNEL_EXPONENT_OFFSET;
+    double m = bits_double((bits & KERNEL_MANTISSA_MASK) | KERNEL_ONE_BITS);
+    double big = (m > KERNEL_SQRT2) ? 1.0 : 0.0;
+    double s, z, p, t, k, r;
+    uint64_t scale;
+    size_t i;
+
+    // log(x) = e log(2) + log(m) with m in [sqrt(1/2), sqrt(2)) and log(m) = 2 atanh((m - 1) / (m + 1))
+    m *= 1.0 - 0.5 * big;
+    e += big;
+    s = (m - 1) / (m + 1);
+    z = s * s;
+    p = KERNEL_LOG_COEFFS[0];
+    for(i = 1; i < KERNEL_LOG_TERMS; i++)
+        p = p * z + KERNEL_LOG_COEFFS[i];
+    t = y * (e * KERNEL_LN2_HI + (e * KERNEL_LN2_LO + (2 * s + 2 * s * z * p)));
+
+    // exp(t) = 2^k exp(r) with k = round(t / log(2)) and |r| <= log(2) / 2
+    t = (t > KERNEL_EXP_MAX) ? KERNEL_EXP_MAX : t;
+    t = (t < KERNEL_EXP_MIN) ? KERNEL_EXP_MIN : t;
+    k = t * KERNEL_INV_LN2 + KERNEL_ROUND;
+    scale = (double_bits(k) - double_bits(KERNEL_ROUND) + 1023) << 52;
+    k -= KERNEL_ROUND;
+    r = (t - k * KERNEL_LN2_HI) - k * KERNEL_LN2_LO;
+    p = KERNEL_EXP_COEFFS[0];
+    for(i = 1; i < KERNEL_EXP_TERMS; i++)
+        p = p * r + KERNEL_EXP_COEFFS[i];
+    return (1 + (r + r * r * p)) * bits_double(scale);
+}
+
+// Returns kernel_pow(quantity, factor) with the factors 0, 0.5, 1 and 2 computed exactly
+static inline double kernel_unit_power(double quantity, double factor)
+{
+    if(factor == 1)
+        return quantity;
+    else if(factor == 2)
+        return quantity * quantity;
+    else if(factor == 0)
+        return 1;
+    else if(factor == 0.5)
+        return sqrt(quantity);
+    else
+        return kernel_pow(quantity, factor);
+}
+
+// Returns quantity raised to the power of factor, the per-unit multiplier of a DynamicPriceObject's base price
+// The factors handled by the specialized dynamic price functions skip pow here as well, so every dynamic pricing path
+// returns exactly the same result for the same object
+static inline double unit_power(double quantity, double factor)
+{
+    if(factor == 1)
+        return quantity;
+    else if(factor == 2)
+        return quantity * quantity;
+    else if(factor == 0)
+        return 1;
+    else if(factor == 0.5)
+        return sqrt(quantity);
+    else
+        return pow(quantity, factor);
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+typedef double v4df __attribute__((vector_size(32)));
+typedef uint64_t v4du __attribute__((vector_size(32)));
+
+// Selects the elements of a where mask is set and of b elsewhere
+#define V4DF_SELECT(mask, a, b) ((v4df)(((v4du)(mask) & (v4du)(a)) | (~(v4du)(mask) & (v4du)(b))))
+
+// Vector version of kernel_unit_power for every element but the factor 0.5 ones, which are left for the caller
+// Compiled once for SSE2, where each v4df operation is split in two, and once for AVX2
+static inline __attribute__((always_inline)) void unit_power_v4(const double* quantity, const double* factor, double* out, size_t n)
+{
+    v4df x, y, e, m, big, s, z, p, t, k, r, result;
+    v4du bits, scale;
+    size_t i, j;
+
+    for(i = 0; i + 4 <= n; i += 4)
+    {
+        memcpy(&x, &quantity[i], sizeof(x));
+        memcpy(&y, &factor[i], sizeof(y));
+
+        bits = (v4du)x;
+        e = (v4df)((bits >> 52) | KERNEL_EXPONENT_BITS) - KERNEL_EXPONENT_OFFSET;
+        m = (v4df)((bits & KERNEL_MANTISSA_MASK) | KERNEL_ONE_BITS);
+        big = (v4df)((v4du)(m > KERNEL_SQRT2) & double_bits(1.0));
+        m *= 1.0 - 0.5 * big;
+        e += big;
+        s = (m - 1) / (m + 1);
+        z = s * s;
+        p = z * 0 + KERNEL_LOG_COEFFS[0];
+        for(j = 1; j < KERNEL_LOG_TERMS; j++)
+            p = p * z + KERNEL_LOG_COEFFS[j];
+        t = y * (e * KERNEL_LN2_HI + (e * KERNEL_LN2_LO + (2 * s + 2 * s * z * p)));
+
+        t = V4DF_SELECT(t > KERNEL_EXP_MAX, t * 0 + KERNEL_EXP_MAX, t);
+        t = V4DF_SELECT(t < KERNEL_EXP_MIN, t * 0 + KERNEL_EXP_MIN, t);
+        k = t * KERNEL_INV_LN2 + KERNEL_ROUND;
+        scale = ((v4du)k - double_bits(KERNEL_ROUND) + 1023) << 52;
+        k -= KERNEL_ROUND;
+        r = (t - k * KERNEL_LN2_HI) - k * KERNEL_LN2_LO;
+        p = r * 0 + KERNEL_EXP_COEFFS[0];
+        for(j = 1; j < KERNEL_EXP_TERMS; j++)
+            p = p * r + KERNEL_EXP_COEFFS[j];
+        result = (1 + (r + r * r * p)) * (v4df)scale;
+
+        result = V4DF_SELECT(y == 0, x * 0 + 1, result);
+        result = V4DF_SELECT(y == 1, x, result);
+        result = V4DF_SELECT(y == 2, x * x, result);
+        memcpy(&out[i], &result, sizeof(result));
+    }
+    for(; i < n; i++)
+        out[i] = kernel_unit_power(quantity[i], factor[i]);
+}
+
+static void unit_power_sse2(const double* quantity, const double* factor, double* out, size_t n)
+{
+    unit_power_v4(quantity, factor, out, n);
+}
+
+__attribute__((target("avx2"))) static void unit_power_avx2(const double* quantity, const double* factor, double* out, size_t n)
+{
+    unit_power_v4(quantity, factor, out, n);
+}
+
+typedef void (*unit_power_fn)(const double* quantity, const double* factor, double* out, size_t n);
+
+// Version of the kernel price_power uses, chosen from the CPU features on first use
+static _Atomic(unit_power_fn) unit_power_kernel = NULL;
+
+static unit_power_fn resolve_unit_power(void)
+{
+    unit_power_fn kernel = atomic_load_explicit(&unit_power_kernel, memory_order_relaxed);
+
+    if(kernel == NULL)
+    {
+        kernel = __builtin_cpu_supports("avx2") ? unit_power_avx2 : unit_power_sse2;
+        atomic_store_explicit(&unit_power_kernel, kernel, memory_order_relaxed);
+    }
+    return kernel;
+}
+#endif
+
+// Writes quantity[i] raised to the power of factor[i] to out[i] for i = 0 .. n - 1, for quantities greater than 0
+// The results are within a few units in the last place of pow and exact for the factors 0, 0.5, 1 and 2
+// Uses the AVX2 or SSE2 version of the kernel when the CPU supports it and the scalar kernel otherwise, all three
+// return the same results
+void price_power(const double* quantity, const double* factor, double* out, size_t n)
+{
+    size_t i;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    resolve_unit_power()(quantity, factor, out, n);
+    for(i = 0; i < n; i++)
+    {
+        if(factor[i] == 0.5)
+            out[i] = sqrt(quantity[i]);
+    }
+#else
+    for(i = 0; i < n; i++)
+        out[i] = kernel_unit_power(quantity[i], factor[i]);
+#endif
+}
+
+#pragma GCC pop_options
+
+//
+// Worker pool
+//
+
+typedef void (*task_fn)(void* ctx, size_t task);
+
+#define TASK_POOL_MAX_WORKERS 64
+
+// Tasks assigned to one worker, other workers take from it once their own range is done
+typedef struct {
+    _Alignas(64) atomic_size_t next;
+    size_t end;
+} TaskRange;
+
+typedef struct {
+    task_fn func;
+    void* ctx;
+    TaskRange* ranges;
+    unsigned int workers;
+} TaskPool;
+
+typedef struct {
+    pthread_t thread;
+    unsigned int id;
+    unsigned long generation;
+} TaskWorker;
+
+// Helper threads are started on first use and then wait for jobs until parallel_shutdown, the calling thread of a job
+// is worker 0 and helper i is worker i
+// lock is held by the caller for the whole job, so jobs from different threads run one after the other; state guards
+// the job handed to the helpers and stop
+static struct {
+    pthread_mutex_t lock;
+    pthread_mutex_t state;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    TaskPool* job;
+    unsigned long generation;
+    unsigned int active;
+    unsigned int running;
+    unsigned int helpers;
+    bool stop;
+    TaskWorker workers[TASK_POOL_MAX_WORKERS];
+    TaskRange ranges[TASK_POOL_MAX_WORKERS];
+} task_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .state = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+// Set on threads running pool tasks, a job started from inside a task runs inline instead of waiting for the pool
+static _Thread_local bool task_pool_member = false;
+
+// Returns threads, or the number of online processors if threads is 0
+static unsigned int resolve_threads(unsigned int threads)
+{
+    long online;
+
+    if(threads != 0)
+        return threads;
+    online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (online > 0) ? (unsigned int)online : 1;
+}
+
+// Runs the tasks of a worker's own range and then steals the remaining tasks of the other ranges
+static void run_tasks(TaskPool* pool, unsigned int id)
+{
+    TaskRange* range;
+    size_t task;
+    unsigned int i;
+
+    for(i = 0; i < pool->workers; i++)
+    {
+        range = &pool->ranges[(id + i) % pool->workers];
+        while((task = atomic_fetch_add(&range->next, 1)) < range->end)
+            pool->func(pool->ctx, task);
+    }
+}
+
+// Waits for jobs that include this helper and runs its share of each, until the pool is stopped
+static void* task_worker_main(void* arg)
+{
+    TaskWorker* worker = arg;
+    TaskPool* job;
+
+    task_pool_member = true;
+    pthread_mutex_lock(&task_pool.state);
+    for(;;)
+    {
+        while(!task_pool.stop && task_pool.generation == worker->generation)
+            pthread_cond_wait(&task_pool.wake, &task_pool.state);
+        if(task_pool.stop)
+            break;
+        worker->generation = task_pool.generation;
+        if(worker->id >= task_pool.active)
+            continue;
+
+        job = task_pool.job;
+        pthread_mutex_unlock(&task_pool.state);
+        run_tasks(job, worker->id);
+        pthread_mutex_lock(&task_pool.state);
+        if(--task_pool.running == 0)
+            pthread_cond_signal(&task_pool.done);
+    }
+    pthread_mutex_unlock(&task_pool.state);
+    return NULL;
+}
+
+// Starts helpers until there are threads - 1 of them and returns the number of workers available to a job of up to
+// threads workers, fewer if helpers could not be started
+// Must be called with the pool lock held
+static unsigned int task_pool_grow(unsigned int threads)
+{
+    TaskWorker* worker;
+
+    while(task_pool.helpers + 1 < threads)
+    {
+        worker = &task_pool.workers[task_pool.helpers + 1];
+        worker->id = task_pool.helpers + 1;
+        worker->generation = task_pool.generation;
+        if(pthread_create(&worker->thread, NULL, task_worker_main, worker) != 0)
+            break;
+        task_pool.helpers++;
+    }
+    return (task_pool.helpers + 1 < threads) ? task_pool.helpers + 1 : threads;
+}
+
+// Calls func(ctx, task) for every task in 0 .. ntasks - 1 on up to threads threads, including the calling one
+// Each worker starts on its own contiguous share of the tasks and steals from the others when it runs out, so uneven
+// tasks stay balanced
+// The helpers are kept between calls, so a job only costs a wake-up rather than a thread start; the tasks run inline
+// when called from inside another job
+// There is one pool per process, so jobs from concurrent callers are serialized: each waits for the running job to
+// finish before its own starts
+static void parallel_tasks(size_t ntasks, unsigned int threads, task_fn func, void* ctx)
+{
+    TaskPool pool;
+    size_t task;
+    unsigned int i;
+
+    threads = resolve_threads(threads);
+    if(threads > ntasks)
+        threads = (unsigned int)ntasks;
+    if(threads > TASK_POOL_MAX_WORKERS)
+        threads = TASK_POOL_MAX_WORKERS;
+    if(threads <= 1 || task_pool_member)
+    {
+        for(task = 0; task < ntasks; task++)
+            func(ctx, task);
+        return;
+    }
+
+    pthread_mutex_lock(&task_pool.lock);
+    threads = task_pool_grow(threads);
+    pool.func = func;
+    pool.ctx = ctx;
+    pool.ranges = task_pool.ranges;
+    pool.workers = threads;
+    for(i = 0; i < threads; i++)
+    {
+        atomic_store_explicit(&pool.ranges[i].next, ntasks * i / threads, memory_order_relaxed);
+        pool.ranges[i].end = ntasks * (i + 1) / threads;
+    }
+
+    pthread_mutex_lock(&task_pool.state);
+    task_pool.job = &pool;
+    task_pool.active = threads;
+    task_pool.running = threads - 1;
+    task_pool.generation++;
+    pthread_cond_broadcast(&task_pool.wake);
+    pthread_mutex_unlock(&task_pool.state);
+
+    task_pool_member = true;
+    run_tasks(&pool, 0);
+    task_pool_member = false;
+
+    pthread_mutex_lock(&task_pool.state);
+    while(task_pool.running != 0)
+        pthread_cond_wait(&task_pool.done, &task_pool.state);
+    pthread_mutex_unlock(&task_pool.state);
+    pthread_mutex_unlock(&task_pool.lock);
+}
+
+// Stops and joins the helper threads of the worker pool, waiting for a running job to finish first
+// The next parallel call starts new helpers; does nothing when called from inside a job
+void parallel_shutdown(void)
+{
+    unsigned int i;
+
+    if(task_pool_member)
+        return;
+    pthread_mutex_lock(&task_pool.lock);
+    pthread_mutex_lock(&task_pool.state);
+    task_pool.stop = true;
+    pthread_cond_broadcast(&task_pool.wake);
+    pthread_mutex_unlock(&task_pool.state);
+    for(i = 1; i <= task_pool.helpers; i++)
+        pthread_join(task_pool.workers[i].thread, NULL);
+
+    pthread_mutex_lock(&task_pool.state);
+    task_pool.stop = false;
+    task_pool.helpers = 0;
+    pthread_mutex_unlock(&task_pool.state);
+    pthread_mutex_unlock(&task_pool.lock);
+}
+
+// Returns the concrete type of an object based on the price function it was constructed with
+// Objects with user-defined price functions are OBJECT_TYPE_OTHER, as are MemoDynamicPriceObjects so that batch code
+// prices them through object_price and their memo
+ObjectType object_type(Object* obj)
+{
+    if(obj->virtual_func_table.price == (price_fn)static_price)
+        return OBJECT_TYPE_STATIC;
+    else if(obj->virtual_func_table.price == (price_fn)dynamic_price ||
+            obj->virtual_func_table.price == (price_fn)dynamic_price_constant ||
+            obj->virtual_func_table.price == (price_fn)dynamic_price_sqrt ||
+            obj->virtual_func_table.price == (price_fn)dynamic_price_linear ||
+            obj->virtual_func_table.price == (price_fn)dynamic_price_square)
+        return OBJECT_TYPE_DYNAMIC;
+    else
+        return OBJECT_TYPE_OTHER;
+}
+
+// Writes the price of each of the n objects to out, with the same result object_price would return
+// Objects are processed in chunks of PRICE_BATCH_CHUNK, grouped by type so each type is priced in one loop without
+// indirect calls; objects of other types fall back to object_price
+void object_price_batch(Object** objs, size_t n, double* out)
+{
+    size_t static_idx[PRICE_BATCH_CHUNK];
+    size_t dynamic_idx[PRICE_BATCH_CHUNK];
+    double quantity[PRICE_BATCH_CHUNK];
+    double base[PRICE_BATCH_CHUNK];
+    double factor[PRICE_BATCH_CHUNK];
+    double price[PRICE_BATCH_CHUNK];
+    StaticPriceObject* static_obj;
+    DynamicPriceObject* dynamic_obj;
+    size_t start, end, i, k;
+    size_t static_count, dynamic_count;
+
+    for(start = 0; start < n; start = end)
+    {
+        end = (n - start > PRICE_BATCH_CHUNK) ? start + PRICE_BATCH_CHUNK : n;
+        static_count = 0;
+        dynamic_count = 0;
+
+        for(i = start; i < end; i++)
+        {
+            switch(object_type(objs[i]))
+            {
+            case OBJECT_TYPE_STATIC:
+                static_idx[static_count++] = i;
+                break;
+            case OBJECT_TYPE_DYNAMIC:
+                dynamic_idx[dynamic_count++] = i;
+                break;
+            default:
+                out[i] = object_price(objs[i]);
+                break;
+            }
+        }
+
+        for(k = 0; k < static_count; k++)
+        {
+            static_obj = (StaticPriceObject*)objs[static_idx[k]];
+            out[static_idx[k]] = (static_obj->obj.quantity == 0) ? ERR_OUT_OF_STOCK : static_obj->price;
+        }
+
+        for(k = 0; k < dynamic_count; k++)
+        {
+            dynamic_obj = (DynamicPriceObject*)objs[dynamic_idx[k]];
+            quantity[k] = dynamic_obj->obj.quantity;
+            base[k] = dynamic_obj->base;
+            factor[k] = dynamic_obj->factor;
+        }
+        for(k = 0; k < dynamic_count; k++)
+            price[k] = (quantity[k] == 0) ? ERR_OUT_OF_STOCK : unit_power(quantity[k], factor[k]) * base[k];
+        for(k = 0; k < dynamic_count; k++)
+            out[dynamic_idx[k]] = price[k];
+    }
+}
 
 // Compares the price of obj1 with obj2
 // Returns a negative number if the price of obj1 is less than the price of obj2
@@ -50,8 +552,11 @@ void static_price_object_construct(StaticPriceObject* obj, unsigned int quantity
     obj->price = price;
     obj->obj.virtual_func_table.bulk_price =(bulk_price_fn)static_bulk_price;
     obj->obj.virtual_func_table.price = (price_fn)static_price;
+    object_set_dispatch(&obj->obj, OBJECT_TYPE_STATIC);
 }
 
+static void dynamic_price_object_specialize(DynamicPriceObject* obj);
+
 // Initializes a DynamicPriceObject with the given quantity, name, base price, and price scaling factor
 void dynamic_price_object_construct(DynamicPriceObject* obj, unsigned int quantity, const char* name, double base, double factor)
 {
@@ -60,8 +565,70 @@ void dynamic_price_object_construct(DynamicPriceObject* obj, unsigned int quanti
     obj->factor = factor;
     obj->obj.quantity = quantity;
     obj->obj.name = name;
+    dynamic_price_object_specialize(obj);
+}
+
+// Installs the price functions that match the factor of a DynamicPriceObject and tags it with them for tagged dispatch
+// Factors 0, 0.5, 1 and 2 get functions that avoid pow and the per-item bulk loop, any other factor uses the generic ones
+static void dynamic_price_object_specialize(DynamicPriceObject* obj)
+{
+    ObjectDispatch tag = OBJECT_DISPATCH_DYNAMIC;
+
     obj->obj.virtual_func_table.price = (price_fn)dynamic_price;
-	obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price;
+    obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price;
+
+    if(obj->factor == 0)
+    {
+        obj->obj.virtual_func_table.price = (price_fn)dynamic_price_constant;
+        obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price_polynomial;
+        tag = OBJECT_DISPATCH_DYNAMIC_CONSTANT;
+    }
+    else if(obj->factor == 0.5)
+    {
+        obj->obj.virtual_func_table.price = (price_fn)dynamic_price_sqrt;
+        obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price_sqrt;
+        tag = OBJECT_DISPATCH_DYNAMIC_SQRT;
+    }
+    else if(obj->factor == 1)
+    {
+        obj->obj.virtual_func_table.price = (price_fn)dynamic_price_linear;
+        obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price_polynomial;
+        tag = OBJECT_DISPATCH_DYNAMIC_LINEAR;
+    }
+    else if(obj->factor == 2)
+    {
+        obj->obj.virtual_func_table.price = (price_fn)dynamic_price_square;
+        obj->obj.virtual_func_table.bulk_price = (bulk_price_fn)dynamic_bulk_price_polynomial;
+        tag = OBJECT_DISPATCH_DYNAMIC_SQUARE;
+    }
+#ifdef POINTER_TAGGED_DISPATCH
+    obj->obj.type = (unsigned char)tag;
+#else
+    (void)tag;
+#endif
+}
+
+// Initializes a MemoDynamicPriceObject like dynamic_price_object_construct, memoizing its price and bulk price
+// The price is reused while the quantity is unchanged and the bulk price while both the quantity and the number of items requested are unchanged
+void memo_dynamic_price_object_construct(MemoDynamicPriceObject* obj, unsigned int quantity, const char* name, double base, double factor)
+{
+    dynamic_price_object_construct(&obj->dynamic, quantity, name, base, factor);
+    memset(&obj->memo, 0, sizeof(obj->memo));
+    obj->dynamic.obj.virtual_func_table.price = (price_fn)memo_dynamic_price;
+    obj->dynamic.obj.virtual_func_table.bulk_price = (bulk_price_fn)memo_dynamic_bulk_price;
+    object_set_dispatch(&obj->dynamic.obj, OBJECT_TYPE_OTHER);
+}
+
+// Changes the base price and price scaling factor of a DynamicPriceObject
+// The object of a MemoDynamicPriceObject keeps its memoized price functions and has its memoized prices dropped
+void dynamic_price_object_set_price(DynamicPriceObject* obj, double base, double factor)
+{
+    obj->base = base;
+    obj->factor = factor;
+    if(obj->obj.virtual_func_table.price == (price_fn)memo_dynamic_price)
+        memo_dynamic_price_object_invalidate((MemoDynamicPriceObject*)obj);
+    else
+        dynamic_price_object_specialize(obj);
 }
 
 // Returns the price of a StaticPriceObject or ERR_OUT_OF_STOCK if it is out of stock
@@ -83,10 +650,44 @@ double dynamic_price(DynamicPriceObject* obj)
     if(obj->obj.quantity == 0)
     	return ERR_OUT_OF_STOCK;
     
-    price = (pow((obj->obj.quantity),(obj->factor)))*(obj->base);
+    price = unit_power(obj->obj.quantity, obj->factor) * obj->base;
     return price;  
 }
 
+// Returns the price of a DynamicPriceObject with a scaling factor of 0 or ERR_OUT_OF_STOCK if it is out of stock
+double dynamic_price_constant(DynamicPriceObject* obj)
+{
+    if(obj->obj.quantity == 0)
+        return ERR_OUT_OF_STOCK;
+    return obj->base;
+}
+
+// Returns the price of a DynamicPriceObject with a scaling factor of 0.5 or ERR_OUT_OF_STOCK if it is out of stock
+double dynamic_price_sqrt(DynamicPriceObject* obj)
+{
+    if(obj->obj.quantity == 0)
+        return ERR_OUT_OF_STOCK;
+    return sqrt(obj->obj.quantity) * obj->base;
+}
+
+// Returns the price of a DynamicPriceObject with a scaling factor of 1 or ERR_OUT_OF_STOCK if it is out of stock
+double dynamic_price_linear(DynamicPriceObject* obj)
+{
+    if(obj->obj.quantity == 0)
+        return ERR_OUT_OF_STOCK;
+    return (double)obj->obj.quantity * obj->base;
+}
+
+// Returns the price of a DynamicPriceObject with a scaling factor of 2 or ERR_OUT_OF_STOCK if it is out of stock
+double dynamic_price_square(DynamicPriceObject* obj)
+{
+    double quantity = obj->obj.quantity;
+
+    if(obj->obj.quantity == 0)
+        return ERR_OUT_OF_STOCK;
+    return quantity * quantity * obj->base;
+}
+
 // Returns the bulk price of purchasing multiple (indicated by quantity parameter) StaticPriceObject at a discount where the first item is regular price and the additional items are scaled by the BULK_DISCOUNT factor
 // Return ERR_OUT_OF_STOCK of there is insufficient quantity available
 double static_bulk_price(StaticPriceObject* obj, unsigned int quantity)
@@ -116,35 +717,322 @@ double static_bulk_price(StaticPriceObject* obj, unsigned int quantity)
 	}
 }
 
+// Returns the sum of k^factor for k = 1 .. n
+// Integer factors 0 through 3 use the exact Faulhaber closed forms and any other factor sums the first terms
+// directly and approximates the tail with the Euler-Maclaurin formula, so the cost does not depend on n
+static double power_sum(unsigned int n, double factor)
+{
+    // B_2j / (2j)! for j = 1 .. 6
+    static const double em_coeffs[] = {
+        1.0 / 12.0, -1.0 / 720.0, 1.0 / 30240.0, -1.0 / 1209600.0, 1.0 / 47900160.0, -691.0 / 1307674368000.0
+    };
+    double dn = (double)n;
+    double da = (double)POWER_SUM_EM_START;
+    double sum = 0;
+    double integral, deriv_coeff, deriv_a, deriv_n;
+    unsigned int k;
+    size_t j;
+
+    if(factor == 0)
+        return dn;
+    else if(factor == 1)
+        return dn * (dn + 1) / 2;
+    else if(factor == 2)
+        return dn * (dn + 1) * (2 * dn + 1) / 6;
+    else if(factor == 3)
+        return (dn * (dn + 1) / 2) * (dn * (dn + 1) / 2);
+
+    if(n <= POWER_SUM_EM_START)
+    {
+        for(k = n; k != 0; k--)
+            sum += pow(k, factor);
+        return sum;
+    }
+
+    // Terms below the start point are summed directly, the derivatives there are too large for the series
+    for(k = POWER_SUM_EM_START - 1; k != 0; k--)
+        sum += pow(k, factor);
+
+    // Integral of x^factor from a to n, written to stay accurate when factor is close to -1
+    if(factor == -1)
+        integral = log(dn / da);
+    else
+        integral = pow(da, factor + 1) * expm1((factor + 1) * log(dn / da)) / (factor + 1);
+
+    sum += integral + (pow(da, factor) + pow(dn, factor)) / 2;
+
+    // Odd derivatives f^(2j-1)(x) = factor (factor - 1) ... (factor - 2j + 2) x^(factor - 2j + 1)
+    deriv_coeff = factor;
+    deriv_a = pow(da, factor - 1);
+    deriv_n = pow(dn, factor - 1);
+    for(j = 0; j < sizeof(em_coeffs) / sizeof(em_coeffs[0]); j++)
+    {
+        sum += em_coeffs[j] * deriv_coeff * (deriv_n - deriv_a);
+        deriv_coeff *= (factor - (double)(2 * j + 1)) * (factor - (double)(2 * j + 2));
+        deriv_a /= da * da;
+        deriv_n /= dn * dn;
+    }
+
+    return sum;
+}
+
+// Returns the bulk price of quantity items of a DynamicPriceObject like dynamic_bulk_price, given the price of the first item
+// The caller checks the quantity available and that quantity is not 0
+static double dynamic_bulk_price_from(DynamicPriceObject* obj, unsigned int quantity, double obj1_price)
+{
+    double bulk_price;
+    double total = 0;
+    double units[BULK_PRICE_LOOP_MAX];
+    double factors[BULK_PRICE_LOOP_MAX];
+    double unit_prices[BULK_PRICE_LOOP_MAX];
+    unsigned int k;
+
+    quantity--;
+    if(quantity > BULK_PRICE_LOOP_MAX)
+        return power_sum(quantity, obj->factor) * obj->base * BULK_DISCOUNT + obj1_price;
+
+    if(quantity == 0)
+        return obj1_price;
+
+    for(k = 0; k < quantity; k++)
+    {
+        units[k] = k + 1;
+        factors[k] = obj->factor;
+    }
+    price_power(units, factors, unit_prices, quantity);
+
+    while (quantity != 0)
+    {
+        bulk_price = unit_prices[quantity - 1] * obj->base * BULK_DISCOUNT;
+        total += bulk_price;
+        quantity--;
+    }
+
+    total += obj1_price;
+    return total;
+}
+
 // Returns the bulk price of purchasing multiple (indicated by quantity parameter) DynamicPriceObject at a discount where the first item is regular price and the additional items are scaled by the BULK_DISCOUNT factor
 // This uses the same dynamic price equation from the dynamic_price function, and note that the price changes for each item that is bought
 // For example, if 3 items are requested, each of them will have a different price, and this function calculates the total price of all 3 items
+// Orders larger than BULK_PRICE_LOOP_MAX are priced with power_sum instead of one pow call per item
 // Return ERR_OUT_OF_STOCK of there is insufficient quantity available
 double dynamic_bulk_price(DynamicPriceObject* obj, unsigned int quantity)
 {
     // IMPLEMENT THIS
-    double obj1_price, bulk_price;
-    double total = 0;
-
     if(obj->obj.quantity < quantity)
     	return ERR_OUT_OF_STOCK;
 	else if(quantity == 0)
 		return 0;
 	else
-	{
-	    obj1_price = object_price((Object*)obj);
-	    quantity--;
+		return dynamic_bulk_price_from(obj, quantity, object_price((Object*)obj));
+}
 
-		while (quantity != 0)
-		{
-			bulk_price = (pow((quantity),(obj->factor)))*(obj->base)*BULK_DISCOUNT;
-			total += bulk_price;
-			quantity--;
-		}
+// Returns the price of a MemoDynamicPriceObject like dynamic_price, reusing the last result while the quantity is unchanged
+double memo_dynamic_price(MemoDynamicPriceObject* obj)
+{
+    if(obj->memo.price_valid && obj->memo.price_quantity == obj->dynamic.obj.quantity)
+    {
+        obj->memo.hits++;
+        return obj->memo.price;
+    }
 
-		total += obj1_price;
-		return total;
-	}
+    obj->memo.misses++;
+    obj->memo.price = dynamic_price(&obj->dynamic);
+    obj->memo.price_quantity = obj->dynamic.obj.quantity;
+    obj->memo.price_valid = true;
+    return obj->memo.price;
+}
+
+// Returns the bulk price of a MemoDynamicPriceObject like dynamic_bulk_price, reusing the last result while the
+// quantity available and the quantity requested are unchanged
+// A miss prices the first item without going through memo_dynamic_price so that each call counts as one lookup
+double memo_dynamic_bulk_price(MemoDynamicPriceObject* obj, unsigned int quantity)
+{
+    double obj1_price;
+
+    if(obj->memo.bulk_valid && obj->memo.bulk_stock == obj->dynamic.obj.quantity && obj->memo.bulk_quantity == quantity)
+    {
+        obj->memo.hits++;
+        return obj->memo.bulk_price;
+    }
+
+    obj->memo.misses++;
+    if(obj->dynamic.obj.quantity < quantity)
+        obj->memo.bulk_price = ERR_OUT_OF_STOCK;
+    else if(quantity == 0)
+        obj->memo.bulk_price = 0;
+    else
+    {
+        if(obj->memo.price_valid && obj->memo.price_quantity == obj->dynamic.obj.quantity)
+            obj1_price = obj->memo.price;
+        else
+            obj1_price = dynamic_price(&obj->dynamic);
+        obj->memo.bulk_price = dynamic_bulk_price_from(&obj->dynamic, quantity, obj1_price);
+    }
+    obj->memo.bulk_stock = obj->dynamic.obj.quantity;
+    obj->memo.bulk_quantity = quantity;
+    obj->memo.bulk_valid = true;
+    return obj->memo.bulk_price;
+}
+
+// Returns the bulk price of a DynamicPriceObject with a scaling factor of 0, 1 or 2 like dynamic_bulk_price
+// The additional items are always summed with the closed form from power_sum, whatever the quantity
+double dynamic_bulk_price_polynomial(DynamicPriceObject* obj, unsigned int quantity)
+{
+    if(obj->obj.quantity < quantity)
+        return ERR_OUT_OF_STOCK;
+    else if(quantity == 0)
+        return 0;
+    return power_sum(quantity - 1, obj->factor) * obj->base * BULK_DISCOUNT + object_price((Object*)obj);
+}
+
+// Returns the bulk price of a DynamicPriceObject with a scaling factor of 0.5 like dynamic_bulk_price
+double dynamic_bulk_price_sqrt(DynamicPriceObject* obj, unsigned int quantity)
+{
+    double total = 0;
+
+    if(obj->obj.quantity < quantity)
+        return ERR_OUT_OF_STOCK;
+    else if(quantity == 0)
+        return 0;
+
+    quantity--;
+    if(quantity > BULK_PRICE_LOOP_MAX)
+        return power_sum(quantity, 0.5) * obj->base * BULK_DISCOUNT + object_price((Object*)obj);
+
+    for(; quantity != 0; quantity--)
+        total += sqrt(quantity) * obj->base * BULK_DISCOUNT;
+    return total + object_price((Object*)obj);
+}
+
+typedef struct {
+    Object** objs;
+    const unsigned int* quantities;
+    size_t n;
+    double* out;
+} BulkQuote;
+
+// Prices one task's worth of (object, quantity) pairs
+static void bulk_quote_task(void* ctx, size_t task)
+{
+    BulkQuote* quote = ctx;
+    size_t start = task * BULK_QUOTE_TASK_SIZE;
+    size_t end = (quote->n - start > BULK_QUOTE_TASK_SIZE) ? start + BULK_QUOTE_TASK_SIZE : quote->n;
+    size_t i;
+
+    for(i = start; i < end; i++)
+        quote->out[i] = object_bulk_price(quote->objs[i], quote->quantities[i]);
+}
+
+// Writes object_bulk_price(objs[i], quantities[i]) to out[i] for i = 0 .. n - 1 using up to threads threads
+// (0 uses one per processor); batches of at most BULK_QUOTE_INLINE_MAX pairs are priced on the calling thread
+// Pairs are handed out in tasks of BULK_QUOTE_TASK_SIZE, so one expensive quote only delays its own task
+// Objects that memoize their prices must not appear more than once in a batch
+void object_bulk_price_parallel(Object** objs, const unsigned int* quantities, size_t n, double* out, unsigned int threads)
+{
+    BulkQuote quote = {objs, quantities, n, out};
+    size_t tasks = (n + BULK_QUOTE_TASK_SIZE - 1) / BULK_QUOTE_TASK_SIZE;
+
+    if(n <= BULK_QUOTE_INLINE_MAX)
+        threads = 1;
+    parallel_tasks(tasks, threads, bulk_quote_task, &quote);
+}
+
+//
+// Price curve functions
+//
+
+// Fills the prefix sums of a price curve from the current base and factor of its object
+// prefix[k] is the discounted price of the 2nd through (k + 1)th items of a bulk purchase
+static void price_curve_fill(PriceCurve* curve)
+{
+    double units[PRICE_BATCH_CHUNK];
+    double factors[PRICE_BATCH_CHUNK];
+    double unit_prices[PRICE_BATCH_CHUNK];
+    double sum = 0;
+    unsigned int start, count, k;
+
+    curve->base = curve->obj->base;
+    curve->factor = curve->obj->factor;
+    curve->prefix[0] = 0;
+    for(start = 1; start < curve->max_quantity; start += count)
+    {
+        count = curve->max_quantity - start;
+        if(count > PRICE_BATCH_CHUNK)
+            count = PRICE_BATCH_CHUNK;
+        for(k = 0; k < count; k++)
+        {
+            units[k] = start + k;
+            factors[k] = curve->factor;
+        }
+        price_power(units, factors, unit_prices, count);
+        for(k = 0; k < count; k++)
+        {
+            sum += unit_prices[k] * curve->base * BULK_DISCOUNT;
+            curve->prefix[start + k] = sum;
+        }
+    }
+}
+
+// Rebuilds the prefix sums if the base price or scaling factor of the object changed since they were filled
+static void price_curve_refresh(PriceCurve* curve)
+{
+    if(curve->base != curve->obj->base || curve->factor != curve->obj->factor)
+        price_curve_fill(curve);
+}
+
+// Builds a price curve that answers bulk price queries for obj of up to max_quantity items in constant time
+// Returns ERR_OUT_OF_MEMORY if the prefix sums could not be allocated or 0 otherwise
+int price_curve_build(PriceCurve* curve, DynamicPriceObject* obj, unsigned int max_quantity)
+{
+    curve->obj = obj;
+    curve->max_quantity = (max_quantity > 0) ? max_quantity : 1;
+    curve->prefix = malloc(curve->max_quantity * sizeof(*curve->prefix));
+    if(curve->prefix == NULL)
+        return ERR_OUT_OF_MEMORY;
+    price_curve_fill(curve);
+    return 0;
+}
+
+// Frees the prefix sums of a price curve
+void price_curve_destroy(PriceCurve* curve)
+{
+    free(curve->prefix);
+    curve->prefix = NULL;
+    curve->max_quantity = 0;
+}
+
+// Returns the bulk price of quantity items of the curve's object like dynamic_bulk_price
+// The curve is rebuilt first if base or factor changed, and quantities beyond the curve fall back to object_bulk_price
+double price_curve_bulk_price(PriceCurve* curve, unsigned int quantity)
+{
+    if(quantity > curve->max_quantity)
+        return object_bulk_price((Object*)curve->obj, quantity);
+    else if(curve->obj->obj.quantity < quantity)
+        return ERR_OUT_OF_STOCK;
+    else if(quantity == 0)
+        return 0;
+
+    price_curve_refresh(curve);
+    return object_price((Object*)curve->obj) + curve->prefix[quantity - 1];
+}
+
+// Writes the bulk price of q items of the curve's object to out[q] for q = 0 .. max_quantity in one pass
+void price_curve_ladder(PriceCurve* curve, double* out, unsigned int max_quantity)
+{
+    unsigned int stock = curve->obj->obj.quantity;
+    unsigned int end = (max_quantity < curve->max_quantity) ? max_quantity : curve->max_quantity;
+    double first;
+    unsigned int q;
+
+    price_curve_refresh(curve);
+    first = object_price((Object*)curve->obj);
+    out[0] = 0;
+    for(q = 1; q <= end; q++)
+        out[q] = (q > stock) ? ERR_OUT_OF_STOCK : first + curve->prefix[q - 1];
+    for(; q <= max_quantity && q != 0; q++)
+        out[q] = object_bulk_price((Object*)curve->obj, q);
 }
 
 //
@@ -159,6 +1047,46 @@ void iterator_begin(LinkedListIterator* iter, LinkedListNode** head)
     iter->prev_next = head;
 }
 
+// Prefetch distance used by foreach, max_min_avg_price and merge, 0 turns prefetching off
+static unsigned int list_prefetch_distance = 16;
+
+// Sets how many nodes ahead foreach, max_min_avg_price and merge prefetch objects, 0 turns prefetching off
+// length never reads objects so it does not prefetch
+// Must not be changed while other threads traverse lists
+void list_set_prefetch_distance(unsigned int distance)
+{
+    list_prefetch_distance = distance;
+}
+
+// Initializes an iterator to the beginning of a list that prefetches distance nodes ahead of the current one
+// A second pointer walks the list distance nodes ahead and prefetches the object of each node it passes, so the
+// iterator only waits on the chain of next pointers instead of on each node and then on its object
+// With distance 0 this is iterator_begin
+void iterator_begin_prefetch(PrefetchListIterator* iter, LinkedListNode** head, unsigned int distance)
+{
+    LinkedListNode* ahead = *head;
+
+    iterator_begin(&iter->iter, head);
+    for(; distance > 0 && ahead != NULL; distance--)
+    {
+        __builtin_prefetch(ahead->obj);
+        ahead = ahead->next;
+    }
+    iter->ahead = ahead;
+}
+
+// Moves a prefetching iterator to the next element like iterator_next and prefetches the object one node further ahead
+// Nodes inserted or removed through the iter member are only prefetched if they are still ahead of the prefetch pointer
+void prefetch_iterator_next(PrefetchListIterator* iter)
+{
+    iterator_next(&iter->iter);
+    if(iter->ahead != NULL)
+    {
+        __builtin_prefetch(iter->ahead->obj);
+        iter->ahead = iter->ahead->next;
+    }
+}
+
 // Updates an iterator to move to the next element in the list if possible
 void iterator_next(LinkedListIterator* iter)
 {
@@ -220,7 +1148,7 @@ int iterator_insert_after(LinkedListIterator* iter, LinkedListNode* node)
     node->next = iter->curr->next;
     iter->curr->next = node;
 
-	return 0;
+    return 0;
 }
 
 // Inserts node before the current node referenced by the iterator
@@ -233,6 +1161,52 @@ void iterator_insert_before(LinkedListIterator* iter, LinkedListNode* node)
     node->next = iter->curr;
 }
 
+// Initializes a tracked iterator to the beginning of a list whose prices are tracked by aggregate
+// It is moved and read through its iter member like a plain iterator
+void iterator_begin_tracked(TrackedListIterator* iter, LinkedListNode** head, PriceAggregate* aggregate)
+{
+    iterator_begin(&iter->iter, head);
+    iter->aggregate = aggregate;
+}
+
+// Removes the current node like iterator_remove, stores it in *node and removes its price from the aggregate
+// Returns the error from price_aggregate_remove or 0 otherwise, the node is removed from the list either way
+int tracked_iterator_remove(TrackedListIterator* iter, LinkedListNode** node)
+{
+    *node = iterator_remove(&iter->iter);
+    return price_aggregate_remove(iter->aggregate, object_price((*node)->obj));
+}
+
+// Inserts node after the current node like iterator_insert_after and adds its price to the aggregate
+// Returns ERR_INSERT_AFTER_END if the iterator is at the end of the list, the error from price_aggregate_add, or 0
+// otherwise
+int tracked_iterator_insert_after(TrackedListIterator* iter, LinkedListNode* node)
+{
+    if(iterator_insert_after(&iter->iter, node) != 0)
+        return ERR_INSERT_AFTER_END;
+    return price_aggregate_add(iter->aggregate, object_price(node->obj));
+}
+
+// Inserts node before the current node like iterator_insert_before and adds its price to the aggregate
+// Returns the error from price_aggregate_add or 0 otherwise, the node is inserted either way
+int tracked_iterator_insert_before(TrackedListIterator* iter, LinkedListNode* node)
+{
+    iterator_insert_before(&iter->iter, node);
+    return price_aggregate_add(iter->aggregate, object_price(node->obj));
+}
+
+// Changes the quantity of the current object, which may change its price, and moves it to its new price in the
+// aggregate; the iterator must not be at the end of the list
+// Returns the error from price_aggregate_update or 0 otherwise
+int tracked_iterator_set_quantity(TrackedListIterator* iter, unsigned int quantity)
+{
+    Object* obj = iterator_get_object(&iter->iter);
+    double old_price = object_price(obj);
+
+    obj->quantity = quantity;
+    return price_aggregate_update(iter->aggregate, old_price, object_price(obj));
+}
+
 //
 // List functions
 //
@@ -241,7 +1215,7 @@ void iterator_insert_before(LinkedListIterator* iter, LinkedListNode* node)
 void max_min_avg_price(LinkedListNode** head, double* max, double* min, double* avg)
 {
     // IMPLEMENT THIS
-    LinkedListIterator iter;
+    PrefetchListIterator iter;
     Object* obj;
     Object* init;
     double init_price;
@@ -249,17 +1223,17 @@ void max_min_avg_price(LinkedListNode** head, double* max, double* min, double*
     double price_sum = 0;
     int counter = 0;
 
-    iterator_begin(&iter, head);
+    iterator_begin_prefetch(&iter, head, list_prefetch_distance);
     
-    init = iterator_get_object(&iter);
+    init = iterator_get_object(&iter.iter);
     init_price = object_price(init);
 
     *max = init_price;
     *min = init_price;
 
-    while(iterator_at_end(&iter) == false)
+    while(iterator_at_end(&iter.iter) == false)
 	{
-		obj = iterator_get_object(&iter);
+		obj = iterator_get_object(&iter.iter);
 		obj_price = object_price(obj);
 
 		if(obj_price > *max)
@@ -269,38 +1243,277 @@ void max_min_avg_price(LinkedListNode** head, double* max, double* min, double*
 		
 		price_sum += obj_price;
 		counter++;
-		iterator_next(&iter);
+		prefetch_iterator_next(&iter);
 	}
 
 	*avg = price_sum/counter;
 
 } 
 
-// Executes the func function for each node in the list
-// The function takes in an input data and returns an output data, which is used as input to the next call to the function
-// The initial input data is provided as a parameter to foreach, and foreach returns the final output data
-// For example, if there are three nodes, foreach should behave like: return func(node3, func(node2, func(node1, data)))
-Data foreach(LinkedListNode** head, foreach_fn func, Data data)
-{
-    // IMPLEMENT THIS
-    // iterator at the head store the result in data d
-    LinkedListIterator iter;
-    Object* node;
+// Partial max, min and compensated sum over one block of a list snapshot
+typedef struct {
+    double max;
+    double min;
+    double sum;
+    double compensation;
+} PriceSummary;
 
-    iterator_begin(&iter, head);
+typedef struct {
+    Object** objs;
+    size_t n;
+    PriceSummary* partials;
+} PriceSummaryJob;
 
-    while(iterator_at_end(&iter) == false)
-	{
-		node = iterator_get_object(&iter);
-		data = func(node, data);
-		iterator_next(&iter);
-	}
+// Adds x to the compensated sum held in *sum and *compensation
+static void neumaier_add(double* sum, double* compensation, double x)
+{
+    double t = *sum + x;
 
-    return data;
+    if(fabs(*sum) >= fabs(x))
+        *compensation += (*sum - t) + x;
+    else
+        *compensation += (x - t) + *sum;
+    *sum = t;
 }
 
-// Returns the length of the list
-int length(LinkedListNode** head)
+// Summarizes one block of PRICE_SUMMARY_BLOCK objects, pricing them in batches
+static void price_summary_task(void* ctx, size_t task)
+{
+    PriceSummaryJob* job = ctx;
+    PriceSummary* partial = &job->partials[task];
+    double prices[PRICE_BATCH_CHUNK];
+    size_t start = task * PRICE_SUMMARY_BLOCK;
+    size_t end = (job->n - start > PRICE_SUMMARY_BLOCK) ? start + PRICE_SUMMARY_BLOCK : job->n;
+    size_t chunk, i;
+
+    partial->max = -INFINITY;
+    partial->min = INFINITY;
+    partial->sum = 0;
+    partial->compensation = 0;
+    for(; start < end; start += chunk)
+    {
+        chunk = (end - start > PRICE_BATCH_CHUNK) ? PRICE_BATCH_CHUNK : end - start;
+        object_price_batch(&job->objs[start], chunk, prices);
+        for(i = 0; i < chunk; i++)
+        {
+            if(prices[i] > partial->max)
+                partial->max = prices[i];
+            if(prices[i] < partial->min)
+                partial->min = prices[i];
+            neumaier_add(&partial->sum, &partial->compensation, prices[i]);
+        }
+    }
+}
+
+// Combines partials[0 .. n - 1] by pairwise halving, the order of the additions only depends on n
+static PriceSummary price_summary_combine(PriceSummary* partials, size_t n)
+{
+    PriceSummary left, right;
+
+    if(n == 1)
+        return partials[0];
+    left = price_summary_combine(partials, n / 2);
+    right = price_summary_combine(partials + n / 2, n - n / 2);
+    left.max = (right.max > left.max) ? right.max : left.max;
+    left.min = (right.min < left.min) ? right.min : left.min;
+    neumaier_add(&left.sum, &left.compensation, right.sum);
+    left.compensation += right.compensation;
+    return left;
+}
+
+// Computes the maximum, minimum, and average price like max_min_avg_price using up to threads threads, or the number
+// of online processors if threads is 0
+// The list is copied into an array and split into fixed blocks of PRICE_SUMMARY_BLOCK, each summed with compensation
+// and then combined pairwise, so the average is bit-identical for any thread count; all three are 0 for an empty list
+// Returns ERR_OUT_OF_MEMORY if the snapshot could not be allocated or 0 otherwise
+int max_min_avg_price_parallel(LinkedListNode** head, double* max, double* min, double* avg, unsigned int threads)
+{
+    PriceSummaryJob job;
+    PriceSummary total;
+    LinkedListNode* node;
+    size_t blocks, i;
+
+    *max = 0;
+    *min = 0;
+    *avg = 0;
+    job.n = 0;
+    for(node = *head; node != NULL; node = node->next)
+        job.n++;
+    if(job.n == 0)
+        return 0;
+
+    blocks = (job.n + PRICE_SUMMARY_BLOCK - 1) / PRICE_SUMMARY_BLOCK;
+    job.objs = malloc(job.n * sizeof(Object*));
+    job.partials = malloc(blocks * sizeof(PriceSummary));
+    if(job.objs == NULL || job.partials == NULL)
+    {
+        free(job.objs);
+        free(job.partials);
+        return ERR_OUT_OF_MEMORY;
+    }
+    for(node = *head, i = 0; node != NULL; node = node->next)
+        job.objs[i++] = node->obj;
+
+    parallel_tasks(blocks, threads, price_summary_task, &job);
+    total = price_summary_combine(job.partials, blocks);
+    *max = total.max;
+    *min = total.min;
+    *avg = (total.sum + total.compensation) / (double)job.n;
+
+    free(job.objs);
+    free(job.partials);
+    return 0;
+}
+
+// Executes the func function for each node in the list
+// The function takes in an input data and returns an output data, which is used as input to the next call to the function
+// The initial input data is provided as a parameter to foreach, and foreach returns the final output data
+// For example, if there are three nodes, foreach should behave like: return func(node3, func(node2, func(node1, data)))
+Data foreach(LinkedListNode** head, foreach_fn func, Data data)
+{
+    // IMPLEMENT THIS
+    // iterator at the head store the result in data d
+    PrefetchListIterator iter;
+    Object* node;
+
+    iterator_begin_prefetch(&iter, head, list_prefetch_distance);
+
+    while(iterator_at_end(&iter.iter) == false)
+	{
+		node = iterator_get_object(&iter.iter);
+		data = func(node, data);
+		prefetch_iterator_next(&iter);
+	}
+
+    return data;
+}
+
+// Executes the func function once for each chunk of up to batch consecutive objects of the list, in order
+// Objects are gathered into a stack buffer, so batch is capped at FOREACH_BATCH_MAX and 0 selects it; the data
+// returned by one call is the input of the next like foreach, and the last chunk may be shorter
+Data foreach_batch(LinkedListNode** head, foreach_batch_fn func, Data data, size_t batch)
+{
+    Object* objs[FOREACH_BATCH_MAX];
+    LinkedListNode* node = *head;
+    size_t n;
+
+    if(batch == 0 || batch > FOREACH_BATCH_MAX)
+        batch = FOREACH_BATCH_MAX;
+    while(node != NULL)
+    {
+        for(n = 0; n < batch && node != NULL; n++, node = node->next)
+            objs[n] = node->obj;
+        data = func(objs, n, data);
+    }
+    return data;
+}
+
+typedef struct {
+    LinkedListNode** starts;
+    size_t* lengths;
+    Data* partials;
+    map_fn map;
+    combine_fn combine;
+    Data identity;
+} ParallelFold;
+
+// Folds one segment of a parallel foreach from the identity
+static void fold_segment_task(void* ctx, size_t task)
+{
+    ParallelFold* fold = ctx;
+    LinkedListNode* node = fold->starts[task];
+    Data data = fold->identity;
+    size_t i;
+
+    for(i = 0; i < fold->lengths[task]; i++, node = node->next)
+        data = fold->combine(data, fold->map(node->obj));
+    fold->partials[task] = data;
+}
+
+// Combines partials[0 .. n - 1] in order by pairwise halving, the shape of the tree only depends on n
+static Data fold_combine_tree(Data* partials, size_t n, combine_fn combine)
+{
+    if(n == 1)
+        return partials[0];
+    return combine(fold_combine_tree(partials, n / 2, combine),
+                   fold_combine_tree(partials + n / 2, n - n / 2, combine));
+}
+
+// Returns the fold of combine over map(obj) for every object of the list, in list order, starting from identity
+// combine must be associative with identity as its identity element, map and combine must be safe to call from
+// several threads at once, and combine is never asked to commute
+// The list is split in one pass into segments that are folded concurrently on up to threads threads, or the number of
+// online processors if threads is 0, and the partial results are combined in list order
+// In deterministic mode segments have a fixed size of FOREACH_PARALLEL_BLOCK and are combined in a fixed pairwise
+// tree, so the result is the same for any thread count even when combine is only approximately associative, such as
+// floating-point addition; otherwise there are four segments per thread combined left to right
+// The list is folded on the calling thread if the segment arrays cannot be allocated
+Data foreach_parallel(LinkedListNode** head, map_fn map, combine_fn combine, Data identity, unsigned int threads,
+                      bool deterministic)
+{
+    ParallelFold fold;
+    LinkedListNode* node;
+    Data result;
+    size_t n = 0;
+    size_t count, i, j;
+
+    for(node = *head; node != NULL; node = node->next)
+        n++;
+    if(n == 0)
+        return identity;
+
+    threads = resolve_threads(threads);
+    if(deterministic)
+        count = (n + FOREACH_PARALLEL_BLOCK - 1) / FOREACH_PARALLEL_BLOCK;
+    else
+        count = (4 * (size_t)threads < n) ? 4 * (size_t)threads : n;
+
+    fold.map = map;
+    fold.combine = combine;
+    fold.identity = identity;
+    fold.starts = malloc(count * sizeof(LinkedListNode*));
+    fold.lengths = malloc(count * sizeof(size_t));
+    fold.partials = malloc(count * sizeof(Data));
+    if(fold.starts == NULL || fold.lengths == NULL || fold.partials == NULL)
+    {
+        free(fold.starts);
+        free(fold.lengths);
+        free(fold.partials);
+        result = identity;
+        for(node = *head; node != NULL; node = node->next)
+            result = combine(result, map(node->obj));
+        return result;
+    }
+
+    for(node = *head, i = 0; i < count; i++)
+    {
+        fold.starts[i] = node;
+        fold.lengths[i] = deterministic ? ((n - i * FOREACH_PARALLEL_BLOCK > FOREACH_PARALLEL_BLOCK) ?
+                                           FOREACH_PARALLEL_BLOCK : n - i * FOREACH_PARALLEL_BLOCK)
+                                        : n * (i + 1) / count - n * i / count;
+        for(j = 0; j < fold.lengths[i]; j++)
+            node = node->next;
+    }
+    parallel_tasks(count, threads, fold_segment_task, &fold);
+
+    if(deterministic)
+    {
+        result = fold_combine_tree(fold.partials, count, combine);
+    }
+    else
+    {
+        result = fold.partials[0];
+        for(i = 1; i < count; i++)
+            result = combine(result, fold.partials[i]);
+    }
+    free(fold.starts);
+    free(fold.lengths);
+    free(fold.partials);
+    return result;
+}
+
+// Returns the length of the list
+int length(LinkedListNode** head)
 {
     // IMPLEMENT THIS
     LinkedListIterator iter;
@@ -317,76 +1530,2015 @@ int length(LinkedListNode** head)
 }
 
 //
-// Mergesort
+// List query functions
 //
 
-// Assuming list1 and list2 are sorted lists, merge list2 into list1 while keeping it sorted
-// The sort order is determined by the compare function
-void merge(LinkedListNode** list1_head, LinkedListNode** list2_head, compare_fn compare)
+// Initializes a query computing the aggregates in the LIST_QUERY_* bitmask
+// LIST_QUERY_FOLD and LIST_QUERY_TOP also need list_query_set_fold and list_query_set_top before the query is run
+void list_query_init(ListQuery* query, unsigned int aggregates)
 {
-    // IMPLEMENT THIS
-    LinkedListIterator iter1;
-    LinkedListIterator iter2;
-    Object* obj1;
-    Object* obj2;
-    int result = 0;
+    memset(query, 0, sizeof(*query));
+    query->aggregates = aggregates;
+}
 
-    iterator_begin(&iter1, list1_head);
-    iterator_begin(&iter2, list2_head);
+// Sets the foreach_fn fold of a query and its initial input data, the final output data is left in fold_data
+void list_query_set_fold(ListQuery* query, foreach_fn func, Data data)
+{
+    query->fold = func;
+    query->fold_data = data;
+}
 
-    while(iterator_at_end(&iter2) != true && iterator_at_end(&iter1) != true)
-	{
-		obj1 = iterator_get_object(&iter1);
-		obj2 = iterator_get_object(&iter2);
-		result = compare(obj1,obj2);
-
-		if(result <=  0)
-		{
-			//objects are equal
-			//obj1 should be before obj2
-			iterator_insert_after(&iter1, iter2.curr);
-		}
-		else
-		{
-			//obj1 should be after obj2
-			iterator_insert_before(&iter1, iter2.curr);
-		}
-
-		iterator_remove(&iter2);
-		iterator_next(&iter1);
-	}
+// Sets the caller-owned arrays that receive the n most expensive objects and their prices, most expensive first
+// Objects with equal prices keep their list order
+void list_query_set_top(ListQuery* query, size_t n, Object** objs, double* prices)
+{
+    query->top_capacity = n;
+    query->top_objs = objs;
+    query->top_prices = prices;
 }
 
-// Split the list head in half and place half in the split list
-// For example, if head has 8 nodes, then split will move 4 of them to split_head
-void split(LinkedListNode** head, LinkedListNode** split_head)
+// Offers an object to the top-N arrays of a query
+static void list_query_offer_top(ListQuery* query, Object* obj, double price)
 {
+    size_t i = query->top_count;
 
-    // IMPLEMENT THIS
+    if(i == query->top_capacity)
+    {
+        if(i == 0 || price <= query->top_prices[i - 1])
+            return;
+        i--;
+    }
+    else
+    {
+        query->top_count++;
+    }
+    for(; i > 0 && query->top_prices[i - 1] < price; i--)
+    {
+        query->top_objs[i] = query->top_objs[i - 1];
+        query->top_prices[i] = query->top_prices[i - 1];
+    }
+    query->top_objs[i] = obj;
+    query->top_prices[i] = price;
+}
+
+// Computes every aggregate of the query in a single traversal of the list
+// Objects are gathered in chunks of PRICE_BATCH_CHUNK and priced once with object_price_batch when any price aggregate
+// is requested; the fold is called on each object in list order as foreach would
+// The price minimum and maximum are 0 for an empty list
+void list_query_run(ListQuery* query, LinkedListNode** head)
+{
+    const unsigned int price_aggregates = LIST_QUERY_PRICE_MIN | LIST_QUERY_PRICE_MAX | LIST_QUERY_PRICE_SUM |
+                                          LIST_QUERY_TOP;
+    Object* objs[PRICE_BATCH_CHUNK];
+    double prices[PRICE_BATCH_CHUNK];
+    LinkedListNode* node = *head;
+    bool priced = (query->aggregates & price_aggregates) != 0;
+    double min = INFINITY;
+    double max = -INFINITY;
+    double sum = 0;
+    double compensation = 0;
+    size_t n, i;
+
+    query->count = 0;
+    query->quantity_sum = 0;
+    query->top_count = 0;
+    while(node != NULL)
+    {
+        for(n = 0; n < PRICE_BATCH_CHUNK && node != NULL; n++, node = node->next)
+            objs[n] = node->obj;
+        if(priced)
+            object_price_batch(objs, n, prices);
+
+        for(i = 0; i < n; i++)
+        {
+            if(query->aggregates & LIST_QUERY_QUANTITY_SUM)
+                query->quantity_sum += objs[i]->quantity;
+            if(query->aggregates & LIST_QUERY_FOLD)
+                query->fold_data = query->fold(objs[i], query->fold_data);
+            if(priced == false)
+                continue;
+            if(prices[i] < min)
+                min = prices[i];
+            if(prices[i] > max)
+                max = prices[i];
+            neumaier_add(&sum, &compensation, prices[i]);
+            if(query->aggregates & LIST_QUERY_TOP)
+                list_query_offer_top(query, objs[i], prices[i]);
+        }
+        query->count += n;
+    }
+
+    query->price_min = (query->count > 0 && priced) ? min : 0;
+    query->price_max = (query->count > 0 && priced) ? max : 0;
+    query->price_sum = sum + compensation;
+}
+
+//
+// Price aggregate functions
+//
+
+// Initializes an empty price aggregate
+// An aggregate keeps the count, sum, maximum and minimum of a multiset of prices up to date as prices are added and
+// removed, with the prices kept in a treap ordered by price
+void price_aggregate_init(PriceAggregate* aggregate)
+{
+    aggregate->root = NULL;
+    aggregate->count = 0;
+    aggregate->sum = 0;
+    aggregate->compensation = 0;
+    aggregate->seed = 2463534242u;
+    aggregate->error = 0;
+}
+
+static void price_tree_free(PriceTreeNode* node)
+{
+    if(node == NULL)
+        return;
+    price_tree_free(node->child[0]);
+    price_tree_free(node->child[1]);
+    free(node);
+}
+
+// Frees the prices of an aggregate and leaves it empty
+void price_aggregate_destroy(PriceAggregate* aggregate)
+{
+    price_tree_free(aggregate->root);
+    price_aggregate_init(aggregate);
+}
+
+// Adds the price of every object in the list to an empty aggregate, dropping whatever it held before
+// Afterwards, the tracked_iterator functions keep it up to date; when the price of a tracked object changes other than
+// through tracked_iterator_set_quantity, price_aggregate_update must be given the old and the new price
+// Returns ERR_OUT_OF_MEMORY if a price could not be added or 0 otherwise
+int price_aggregate_attach(PriceAggregate* aggregate, LinkedListNode** head)
+{
     LinkedListIterator iter;
-    int len = 0;
-    int counter = 0;
-    int split = 0;
 
+    price_aggregate_destroy(aggregate);
     iterator_begin(&iter, head);
+    while(iterator_at_end(&iter) == false)
+    {
+        if(price_aggregate_add(aggregate, object_price(iterator_get_object(&iter))) != 0)
+            return ERR_OUT_OF_MEMORY;
+        iterator_next(&iter);
+    }
+    return 0;
+}
 
-    len = length(head);
-    split = len/2;
+// Adds x to the compensated sum of an aggregate
+static void price_aggregate_accumulate(PriceAggregate* aggregate, double x)
+{
+    neumaier_add(&aggregate->sum, &aggregate->compensation, x);
+}
 
-    while(counter != split)
-	{
-		iterator_next(&iter);
-		counter++;
-	}
+// Inserts one occurrence of price into the treap rooted at *link
+static int price_tree_insert(PriceAggregate* aggregate, PriceTreeNode** link, double price)
+{
+    PriceTreeNode* node = *link;
+    PriceTreeNode* child;
+    int side;
 
-    *split_head = iter.curr;
-    *iter.prev_next = NULL;
+    if(node == NULL)
+    {
+        node = malloc(sizeof(*node));
+        if(node == NULL)
+            return ERR_OUT_OF_MEMORY;
+        // xorshift32
+        aggregate->seed ^= aggregate->seed << 13;
+        aggregate->seed ^= aggregate->seed >> 17;
+        aggregate->seed ^= aggregate->seed << 5;
+        node->price = price;
+        node->count = 1;
+        node->priority = aggregate->seed;
+        node->child[0] = NULL;
+        node->child[1] = NULL;
+        *link = node;
+        return 0;
+    }
+    if(node->price == price)
+    {
+        node->count++;
+        return 0;
+    }
 
+    side = price > node->price;
+    if(price_tree_insert(aggregate, &node->child[side], price) != 0)
+        return ERR_OUT_OF_MEMORY;
+
+    // Rotate the child up if it has a higher priority
+    child = node->child[side];
+    if(child->priority > node->priority)
+    {
+        node->child[side] = child->child[!side];
+        child->child[!side] = node;
+        *link = child;
+    }
+    return 0;
 }
 
-// Implement the mergesort algorithm to sort the list
-// The sort order is determined by the compare function
-void mergesort(LinkedListNode** head, compare_fn compare)
+// Removes one occurrence of price from the treap rooted at *link, returns false if it is not there
+static bool price_tree_remove(PriceTreeNode** link, double price)
 {
-    // IMPLEMENT THIS
+    PriceTreeNode* node;
+    PriceTreeNode* child;
+    int side;
+
+    while((node = *link) != NULL && node->price != price)
+        link = &node->child[price > node->price];
+    if(node == NULL)
+        return false;
+    if(--node->count > 0)
+        return true;
+
+    // Rotate the node down until it has at most one child, then splice it out
+    while(node->child[0] != NULL && node->child[1] != NULL)
+    {
+        side = node->child[1]->priority > node->child[0]->priority;
+        child = node->child[side];
+        node->child[side] = child->child[!side];
+        child->child[!side] = node;
+        *link = child;
+        link = &child->child[!side];
+    }
+    *link = (node->child[0] != NULL) ? node->child[0] : node->child[1];
+    free(node);
+    return true;
+}
+
+// Adds a price to an aggregate in O(log n)
+// Returns ERR_OUT_OF_MEMORY if it could not be added, in which case the aggregate reports the error until reattached
+int price_aggregate_add(PriceAggregate* aggregate, double price)
+{
+    if(price_tree_insert(aggregate, &aggregate->root, price) != 0)
+    {
+        aggregate->error = ERR_OUT_OF_MEMORY;
+        return ERR_OUT_OF_MEMORY;
+    }
+    aggregate->count++;
+    price_aggregate_accumulate(aggregate, price);
+    return 0;
+}
+
+// Removes one occurrence of a price from an aggregate in O(log n)
+// Returns ERR_PRICE_NOT_FOUND if the price was never added, in which case the aggregate reports the error until
+// reattached, or 0 otherwise
+int price_aggregate_remove(PriceAggregate* aggregate, double price)
+{
+    if(price_tree_remove(&aggregate->root, price) == false)
+    {
+        aggregate->error = ERR_PRICE_NOT_FOUND;
+        return ERR_PRICE_NOT_FOUND;
+    }
+    aggregate->count--;
+    price_aggregate_accumulate(aggregate, -price);
+    if(aggregate->count == 0)
+    {
+        aggregate->sum = 0;
+        aggregate->compensation = 0;
+    }
+    return 0;
+}
+
+// Replaces one occurrence of old_price in an aggregate with new_price, for a tracked object whose price changed
+// Returns the error from price_aggregate_remove or price_aggregate_add, or 0 otherwise
+int price_aggregate_update(PriceAggregate* aggregate, double old_price, double new_price)
+{
+    int error;
+
+    error = price_aggregate_remove(aggregate, old_price);
+    if(error != 0)
+        return error;
+    return price_aggregate_add(aggregate, new_price);
+}
+
+// Returns the maximum, minimum, and average of the prices in an aggregate like max_min_avg_price, in O(log n)
+// All three are 0 for an empty aggregate
+// Returns the error from a failed price_aggregate_add or price_aggregate_remove since the last attach or 0 otherwise
+int price_aggregate_max_min_avg(PriceAggregate* aggregate, double* max, double* min, double* avg)
+{
+    PriceTreeNode* node;
+
+    *max = 0;
+    *min = 0;
+    *avg = 0;
+    if(aggregate->error != 0)
+        return aggregate->error;
+    if(aggregate->root == NULL)
+        return 0;
+
+    for(node = aggregate->root; node->child[1] != NULL; node = node->child[1])
+        ;
+    *max = node->price;
+    for(node = aggregate->root; node->child[0] != NULL; node = node->child[0])
+        ;
+    *min = node->price;
+    *avg = (aggregate->sum + aggregate->compensation) / (double)aggregate->count;
+    return 0;
+}
+
+//
+// Arena functions
+//
+
+typedef struct ArenaSlab_s {
+    struct ArenaSlab_s* next;
+} ArenaSlab;
+
+struct Arena_s {
+    pthread_mutex_t lock;
+    ArenaSlab* slabs;
+    ArenaSlab* spare;
+    size_t slab_size;
+    bool huge_pages;
+    unsigned long generation;
+};
+
+// Returns an empty arena handing out memory from slabs of slab_size bytes, or ARENA_SLAB_SIZE if it is 0, or NULL if it
+// could not be allocated
+// Slabs are cache-line aligned; with huge_pages they are rounded up to and aligned on ARENA_HUGE_PAGE_SIZE and the
+// kernel is asked to back them with transparent huge pages
+// Memory is handed out through an ArenaCache per thread, so the arena lock is only taken once per slab
+Arena* arena_create(size_t slab_size, bool huge_pages)
+{
+    size_t align = huge_pages ? ARENA_HUGE_PAGE_SIZE : 64;
+    Arena* arena = malloc(sizeof(Arena));
+
+    if(arena == NULL)
+        return NULL;
+    if(slab_size == 0)
+        slab_size = ARENA_SLAB_SIZE;
+    pthread_mutex_init(&arena->lock, NULL);
+    arena->slabs = NULL;
+    arena->spare = NULL;
+    arena->slab_size = (slab_size + align - 1) / align * align;
+    arena->huge_pages = huge_pages;
+    arena->generation = 0;
+    return arena;
+}
+
+static void arena_free_slabs(ArenaSlab* slab)
+{
+    ArenaSlab* next;
+
+    for(; slab != NULL; slab = next)
+    {
+        next = slab->next;
+        free(slab);
+    }
+}
+
+// Releases everything allocated from the arena at once, in time proportional to the number of slabs
+// The slabs are kept for reuse, and every cache of the arena starts over on its next allocation
+// The arena must not be used by other threads during the call
+void arena_reset(Arena* arena)
+{
+    ArenaSlab* slab;
+
+    pthread_mutex_lock(&arena->lock);
+    while((slab = arena->slabs) != NULL)
+    {
+        arena->slabs = slab->next;
+        slab->next = arena->spare;
+        arena->spare = slab;
+    }
+    arena->generation++;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// Frees the arena and every slab of it, invalidating everything allocated from it
+void arena_destroy(Arena* arena)
+{
+    arena_free_slabs(arena->slabs);
+    arena_free_slabs(arena->spare);
+    pthread_mutex_destroy(&arena->lock);
+    free(arena);
+}
+
+// Initializes a cache allocating from arena, each thread using the arena needs its own cache
+void arena_cache_init(ArenaCache* cache, Arena* arena)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->arena = arena;
+    cache->generation = arena->generation;
+}
+
+// Gives the cache a fresh slab to carve from
+// Returns false if no slab could be allocated
+static bool arena_cache_refill(ArenaCache* cache)
+{
+    Arena* arena = cache->arena;
+    ArenaSlab* slab;
+
+    pthread_mutex_lock(&arena->lock);
+    slab = arena->spare;
+    if(slab != NULL)
+    {
+        arena->spare = slab->next;
+    }
+    else
+    {
+        slab = aligned_alloc(arena->huge_pages ? ARENA_HUGE_PAGE_SIZE : 64, arena->slab_size);
+        if(slab != NULL && arena->huge_pages)
+            madvise(slab, arena->slab_size, MADV_HUGEPAGE);
+    }
+    if(slab != NULL)
+    {
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+    }
+    pthread_mutex_unlock(&arena->lock);
+
+    if(slab == NULL)
+        return false;
+    // The slab header takes the first cache line so allocations stay aligned
+    cache->cursor = (char*)slab + 64;
+    cache->limit = (char*)slab + arena->slab_size;
+    return true;
+}
+
+// Returns memory for size bytes from the cache, aligned on ARENA_CLASS_SIZE, or NULL if size is 0, larger than
+// ARENA_CLASS_COUNT * ARENA_CLASS_SIZE, or no slab could be allocated
+// Memory freed to the cache with the same size is reused first, otherwise it is carved from the cache's current slab
+void* arena_alloc(ArenaCache* cache, size_t size)
+{
+    size_t class = (size + ARENA_CLASS_SIZE - 1) / ARENA_CLASS_SIZE;
+    size_t bytes = class * ARENA_CLASS_SIZE;
+    ArenaFree* block;
+    void* ptr;
+
+    if(class == 0 || class > ARENA_CLASS_COUNT)
+        return NULL;
+    if(cache->generation != cache->arena->generation)
+        arena_cache_init(cache, cache->arena);
+
+    block = cache->free[class - 1];
+    if(block != NULL)
+    {
+        cache->free[class - 1] = block->next;
+        return block;
+    }
+    if((size_t)(cache->limit - cache->cursor) < bytes && arena_cache_refill(cache) == false)
+        return NULL;
+    ptr = cache->cursor;
+    cache->cursor += bytes;
+    return ptr;
+}
+
+// Returns memory of size bytes allocated from the same arena to the cache's free list
+// Sizes arena_alloc never hands out, 0 or larger than ARENA_CLASS_COUNT * ARENA_CLASS_SIZE, are ignored
+void arena_free(ArenaCache* cache, void* ptr, size_t size)
+{
+    size_t class = (size + ARENA_CLASS_SIZE - 1) / ARENA_CLASS_SIZE;
+    ArenaFree* block = ptr;
+
+    if(ptr == NULL || class == 0 || class > ARENA_CLASS_COUNT || cache->generation != cache->arena->generation)
+        return;
+    block->next = cache->free[class - 1];
+    cache->free[class - 1] = block;
+}
+
+// Returns a node referencing obj allocated from the cache, or NULL if it could not be allocated
+LinkedListNode* arena_new_node(ArenaCache* cache, Object* obj)
+{
+    LinkedListNode* node = arena_alloc(cache, sizeof(LinkedListNode));
+
+    if(node != NULL)
+    {
+        node->obj = obj;
+        node->next = NULL;
+    }
+    return node;
+}
+
+// Returns a static price object constructed in memory from the cache, or NULL if it could not be allocated
+StaticPriceObject* arena_new_static_price_object(ArenaCache* cache, unsigned int quantity, const char* name, double price)
+{
+    StaticPriceObject* obj = arena_alloc(cache, sizeof(StaticPriceObject));
+
+    if(obj != NULL)
+        static_price_object_construct(obj, quantity, name, price);
+    return obj;
+}
+
+// Returns a dynamic price object constructed in memory from the cache, or NULL if it could not be allocated
+DynamicPriceObject* arena_new_dynamic_price_object(ArenaCache* cache, unsigned int quantity, const char* name, double base,
+                                                   double factor)
+{
+    DynamicPriceObject* obj = arena_alloc(cache, sizeof(DynamicPriceObject));
+
+    if(obj != NULL)
+        dynamic_price_object_construct(obj, quantity, name, base, factor);
+    return obj;
+}
+
+//
+// Inventory table functions
+//
+
+// Initializes an empty inventory table
+void inventory_table_init(InventoryTable* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+// Frees the columns of an inventory table and leaves it empty
+// Names are not owned by the table and are not freed
+void inventory_table_destroy(InventoryTable* table)
+{
+    free(table->quantity);
+    free(table->type);
+    free(table->price);
+    free(table->base);
+    free(table->factor);
+    free(table->name_id);
+    free(table->names);
+    free(table->name_slots);
+    inventory_table_init(table);
+}
+
+// Grows every column of the table to hold at least capacity rows
+// Returns ERR_OUT_OF_MEMORY if any column could not be grown or 0 otherwise
+static int inventory_table_reserve(InventoryTable* table, size_t capacity)
+{
+    void* column;
+
+    if(capacity <= table->capacity)
+        return 0;
+
+#define INVENTORY_TABLE_GROW(field) \
+    column = realloc(table->field, capacity * sizeof(*table->field)); \
+    if(column == NULL) \
+        return ERR_OUT_OF_MEMORY; \
+    table->field = column;
+
+    INVENTORY_TABLE_GROW(quantity)
+    INVENTORY_TABLE_GROW(type)
+    INVENTORY_TABLE_GROW(price)
+    INVENTORY_TABLE_GROW(base)
+    INVENTORY_TABLE_GROW(factor)
+    INVENTORY_TABLE_GROW(name_id)
+#undef INVENTORY_TABLE_GROW
+
+    table->capacity = capacity;
+    return 0;
+}
+
+// Returns the FNV-1a hash of a name, NULL names hash to 0
+static size_t name_hash(const char* name)
+{
+    size_t hash = 2166136261u;
+
+    if(name == NULL)
+        return 0;
+
+    for(; *name != '\0'; name++)
+    {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns true if both names are NULL or have the same characters
+static bool name_equal(const char* name1, const char* name2)
+{
+    if(name1 == NULL || name2 == NULL)
+        return name1 == name2;
+    return strcmp(name1, name2) == 0;
+}
+
+// Returns the id of name in the table, adding it if it is not interned yet
+// Returns ERR_OUT_OF_MEMORY if the name could not be added
+static long inventory_table_intern(InventoryTable* table, const char* name)
+{
+    size_t mask, slot, i;
+    unsigned int id;
+    unsigned int* slots;
+    const char** names;
+
+    // Keep the open addressing table at most half full
+    if(2 * (table->name_count + 1) > table->name_slot_count)
+    {
+        size_t slot_count = (table->name_slot_count == 0) ? 64 : 2 * table->name_slot_count;
+        slots = calloc(slot_count, sizeof(*slots));
+        if(slots == NULL)
+            return ERR_OUT_OF_MEMORY;
+        for(i = 0; i < table->name_count; i++)
+        {
+            slot = name_hash(table->names[i]) & (slot_count - 1);
+            while(slots[slot] != 0)
+                slot = (slot + 1) & (slot_count - 1);
+            slots[slot] = (unsigned int)(i + 1);
+        }
+        free(table->name_slots);
+        table->name_slots = slots;
+        table->name_slot_count = slot_count;
+    }
+
+    mask = table->name_slot_count - 1;
+    for(slot = name_hash(name) & mask; table->name_slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        id = table->name_slots[slot] - 1;
+        if(name_equal(table->names[id], name))
+            return id;
+    }
+
+    if(table->name_count == table->name_capacity)
+    {
+        size_t name_capacity = (table->name_capacity == 0) ? 32 : 2 * table->name_capacity;
+        names = realloc(table->names, name_capacity * sizeof(*names));
+        if(names == NULL)
+            return ERR_OUT_OF_MEMORY;
+        table->names = names;
+        table->name_capacity = name_capacity;
+    }
+
+    id = (unsigned int)table->name_count;
+    table->names[table->name_count++] = name;
+    table->name_slots[slot] = id + 1;
+    return id;
+}
+
+// Appends a copy of obj to the end of the table
+// Returns ERR_UNSUPPORTED_TYPE if obj is not a StaticPriceObject or DynamicPriceObject,
+// ERR_OUT_OF_MEMORY if the table could not grow or 0 otherwise
+int inventory_table_append(InventoryTable* table, Object* obj)
+{
+    ObjectType type = object_type(obj);
+    size_t row = table->length;
+    long id;
+
+    if(type == OBJECT_TYPE_OTHER)
+        return ERR_UNSUPPORTED_TYPE;
+    if(inventory_table_reserve(table, (row == table->capacity) ? 2 * row + 16 : row) != 0)
+        return ERR_OUT_OF_MEMORY;
+    id = inventory_table_intern(table, object_name(obj));
+    if(id < 0)
+        return ERR_OUT_OF_MEMORY;
+
+    table->quantity[row] = object_quantity(obj);
+    table->type[row] = (unsigned char)type;
+    table->name_id[row] = (unsigned int)id;
+    if(type == OBJECT_TYPE_STATIC)
+    {
+        table->price[row] = ((StaticPriceObject*)obj)->price;
+        table->base[row] = 0;
+        table->factor[row] = 0;
+    }
+    else
+    {
+        table->price[row] = 0;
+        table->base[row] = ((DynamicPriceObject*)obj)->base;
+        table->factor[row] = ((DynamicPriceObject*)obj)->factor;
+    }
+    table->length++;
+    return 0;
+}
+
+// Removes a row from the table, the rows after it move up by one so the order is kept
+// Returns ERR_INVALID_ARGUMENT if there is no such row or 0 otherwise
+int inventory_table_remove(InventoryTable* table, size_t row)
+{
+    size_t count;
+
+    if(row >= table->length)
+        return ERR_INVALID_ARGUMENT;
+    count = table->length - row - 1;
+    memmove(&table->quantity[row], &table->quantity[row + 1], count * sizeof(*table->quantity));
+    memmove(&table->type[row], &table->type[row + 1], count * sizeof(*table->type));
+    memmove(&table->price[row], &table->price[row + 1], count * sizeof(*table->price));
+    memmove(&table->base[row], &table->base[row + 1], count * sizeof(*table->base));
+    memmove(&table->factor[row], &table->factor[row + 1], count * sizeof(*table->factor));
+    memmove(&table->name_id[row], &table->name_id[row + 1], count * sizeof(*table->name_id));
+    table->length--;
+    return 0;
+}
+
+// Appends a copy of every object in the list to the table, in list order
+// Returns the first error from inventory_table_append or 0 otherwise, objects before the failing one stay appended
+int inventory_table_import(InventoryTable* table, LinkedListNode** head)
+{
+    LinkedListIterator iter;
+    int result;
+
+    iterator_begin(&iter, head);
+    while(iterator_at_end(&iter) == false)
+    {
+        result = inventory_table_append(table, iterator_get_object(&iter));
+        if(result != 0)
+            return result;
+        iterator_next(&iter);
+    }
+    return 0;
+}
+
+// Rebuilds the rows of the table as objects and links them into a list that replaces head
+// nodes and records must each have room for inventory_table_length(table) entries and stay valid as long as the list is used
+void inventory_table_export(InventoryTable* table, LinkedListNode* nodes, InventoryRecord* records, LinkedListNode** head)
+{
+    size_t row;
+    const char* name;
+
+    for(row = 0; row < table->length; row++)
+    {
+        name = table->names[table->name_id[row]];
+        if(table->type[row] == OBJECT_TYPE_STATIC)
+            static_price_object_construct(&records[row].static_obj, table->quantity[row], name, table->price[row]);
+        else
+            dynamic_price_object_construct(&records[row].dynamic_obj, table->quantity[row], name,
+                                           table->base[row], table->factor[row]);
+        nodes[row].obj = &records[row].obj;
+        nodes[row].next = (row + 1 < table->length) ? &nodes[row + 1] : NULL;
+    }
+    *head = (table->length > 0) ? &nodes[0] : NULL;
+}
+
+// Returns the price of a row, as object_price would for the object it was created from
+double inventory_table_price(InventoryTable* table, size_t row)
+{
+    if(table->quantity[row] == 0)
+        return ERR_OUT_OF_STOCK;
+    else if(table->type[row] == OBJECT_TYPE_STATIC)
+        return table->price[row];
+    else
+        return unit_power(table->quantity[row], table->factor[row]) * table->base[row];
+}
+
+// Returns the name of a row
+const char* inventory_table_name(InventoryTable* table, size_t row)
+{
+    return table->names[table->name_id[row]];
+}
+
+// Returns the number of rows in the table
+int inventory_table_length(InventoryTable* table)
+{
+    return (int)table->length;
+}
+
+// Returns the maximum, minimum, and average price of the rows in the table
+// All three are 0 for an empty table
+void inventory_table_max_min_avg_price(InventoryTable* table, double* max, double* min, double* avg)
+{
+    double price_sum = 0;
+    double obj_price;
+    size_t row;
+
+    *max = 0;
+    *min = 0;
+    *avg = 0;
+    if(table->length == 0)
+        return;
+
+    *max = inventory_table_price(table, 0);
+    *min = *max;
+    for(row = 0; row < table->length; row++)
+    {
+        obj_price = inventory_table_price(table, row);
+        *max = fmax(*max, obj_price);
+        *min = fmin(*min, obj_price);
+        price_sum += obj_price;
+    }
+    *avg = price_sum / (double)table->length;
+}
+
+// Executes the func function for each row in the table, in the same way foreach does for each node in a list
+Data inventory_table_foreach(InventoryTable* table, inventory_foreach_fn func, Data data)
+{
+    size_t row;
+
+    for(row = 0; row < table->length; row++)
+        data = func(table, row, data);
+    return data;
+}
+
+//
+// Mergesort
+//
+
+// Merges the sorted lists list1 and list2 by relinking their nodes, nodes of list1 come first among equal nodes
+// Returns the head of the merged list and stores its last node in *tail
+static LinkedListNode* merge_lists(LinkedListNode* list1, LinkedListNode* list2, compare_fn compare,
+                                   LinkedListNode** tail)
+{
+    LinkedListNode* head = NULL;
+    LinkedListNode** link = &head;
+    LinkedListNode* last = NULL;
+
+    while(list1 != NULL && list2 != NULL)
+    {
+        if(compare(list1->obj, list2->obj) <= 0)
+        {
+            last = list1;
+            list1 = list1->next;
+        }
+        else
+        {
+            last = list2;
+            list2 = list2->next;
+        }
+        *link = last;
+        link = &last->next;
+        // The node after the one taken is compared next, fetch its successor and object while comparing it
+        if(list_prefetch_distance > 0 && last->next != NULL)
+        {
+            __builtin_prefetch(last->next->next);
+            __builtin_prefetch(last->next->obj);
+        }
+    }
+    *link = (list1 != NULL) ? list1 : list2;
+    while(*link != NULL)
+    {
+        last = *link;
+        link = &last->next;
+    }
+    *tail = last;
+    return head;
+}
+
+// Assuming list1 and list2 are sorted lists, merge list2 into list1 while keeping it sorted
+// The sort order is determined by the compare function
+void merge(LinkedListNode** list1_head, LinkedListNode** list2_head, compare_fn compare)
+{
+    LinkedListNode* tail;
+
+    *list1_head = merge_lists(*list1_head, *list2_head, compare, &tail);
+    *list2_head = NULL;
+}
+
+// Split the list head in half and place half in the split list
+// For example, if head has 8 nodes, then split will move 4 of them to split_head
+void split(LinkedListNode** head, LinkedListNode** split_head)
+{
+
+    // IMPLEMENT THIS
+    LinkedListIterator iter;
+    int len = 0;
+    int counter = 0;
+    int split = 0;
+
+    iterator_begin(&iter, head);
+
+    len = length(head);
+    split = len/2;
+
+    while(counter != split)
+	{
+		iterator_next(&iter);
+		counter++;
+	}
+
+    *split_head = iter.curr;
+    *iter.prev_next = NULL;
+
+}
+
+// Cuts the list after its first n nodes and returns the rest of it
+static LinkedListNode* cut_list(LinkedListNode* head, size_t n)
+{
+    LinkedListNode* rest;
+
+    while(head != NULL && n > 1)
+    {
+        head = head->next;
+        n--;
+    }
+    if(head == NULL)
+        return NULL;
+    rest = head->next;
+    head->next = NULL;
+    return rest;
+}
+
+// Implement the mergesort algorithm to sort the list
+// The sort order is determined by the compare function
+// The sort is stable, iterative and bottom-up: each pass merges neighbouring sorted runs of width nodes into runs of
+// twice the width, using O(1) extra space and no length scans, until a pass does a single merge
+void mergesort(LinkedListNode** head, compare_fn compare)
+{
+    LinkedListNode* rest;
+    LinkedListNode* left;
+    LinkedListNode* right;
+    LinkedListNode* tail;
+    LinkedListNode** link;
+    size_t width;
+    size_t merges = 2;
+
+    for(width = 1; merges > 1; width *= 2)
+    {
+        merges = 0;
+        rest = *head;
+        link = head;
+        while(rest != NULL)
+        {
+            left = rest;
+            right = cut_list(left, width);
+            rest = cut_list(right, width);
+            *link = merge_lists(left, right, compare, &tail);
+            link = &tail->next;
+            merges++;
+        }
+        *link = NULL;
+    }
+}
+
+// A sorted run waiting on the natural mergesort stack, power is the powersort node power of its right boundary
+typedef struct {
+    LinkedListNode* head;
+    size_t start;
+    size_t length;
+    unsigned int power;
+} SortRun;
+
+// Cuts the next maximal run off the front of *rest and returns its head, reversing it if it is strictly descending
+// The length of the run is stored in *length
+static LinkedListNode* natural_run(LinkedListNode** rest, compare_fn compare, size_t* length)
+{
+    LinkedListNode* head = *rest;
+    LinkedListNode* last = head;
+    LinkedListNode* next;
+    LinkedListNode* reversed;
+
+    *length = 1;
+    if(head->next == NULL)
+    {
+        *rest = NULL;
+        return head;
+    }
+    if(compare(head->obj, head->next->obj) > 0)
+    {
+        // Strictly descending, so reversing it cannot reorder equal nodes
+        reversed = NULL;
+        do
+        {
+            next = last->next;
+            last->next = reversed;
+            reversed = last;
+            last = next;
+            (*length)++;
+        } while(last->next != NULL && compare(last->obj, last->next->obj) > 0);
+        *rest = last->next;
+        last->next = reversed;
+        return last;
+    }
+    do
+    {
+        last = last->next;
+        (*length)++;
+    } while(last->next != NULL && compare(last->obj, last->next->obj) <= 0);
+    *rest = last->next;
+    last->next = NULL;
+    return head;
+}
+
+// Returns the powersort power of the boundary between the runs [start1, start1 + length1) and
+// [start1 + length1, start1 + length1 + length2) of a list of n nodes
+// This is the first bit where the binary fractions of the two run midpoints relative to n differ
+static unsigned int run_boundary_power(size_t start1, size_t length1, size_t length2, size_t n)
+{
+    uint64_t left = 2 * (uint64_t)start1 + length1;
+    uint64_t right = left + length1 + length2;
+    uint64_t scale = 2 * (uint64_t)n;
+    unsigned int power = 0;
+
+    for(;;)
+    {
+        power++;
+        left *= 2;
+        right *= 2;
+        if((left >= scale) != (right >= scale))
+            return power;
+        if(left >= scale)
+        {
+            left -= scale;
+            right -= scale;
+        }
+    }
+}
+
+// Sorts the list with an adaptive natural mergesort
+// The sort order is determined by the compare function and the sort is stable like mergesort
+// Existing ascending runs are kept and strictly descending runs are reversed in one pass, then runs are merged in the
+// order given by powersort, so a sorted or reverse-sorted list costs n - 1 comparisons and merging k runs costs
+// O(n log k); the run stack holds at most one run per power so it has a fixed size
+void mergesort_natural(LinkedListNode** head, compare_fn compare)
+{
+    SortRun stack[66];
+    SortRun run;
+    SortRun next;
+    LinkedListNode* rest = *head;
+    LinkedListNode* tail;
+    size_t top = 0;
+    size_t n = 0;
+    unsigned int power;
+
+    for(tail = *head; tail != NULL; tail = tail->next)
+        n++;
+    if(n < 2)
+        return;
+
+    run.start = 0;
+    run.head = natural_run(&rest, compare, &run.length);
+    while(rest != NULL)
+    {
+        next.start = run.start + run.length;
+        next.head = natural_run(&rest, compare, &next.length);
+        power = run_boundary_power(run.start, run.length, next.length, n);
+        while(top > 0 && stack[top - 1].power > power)
+        {
+            top--;
+            run.head = merge_lists(stack[top].head, run.head, compare, &tail);
+            run.length += stack[top].length;
+            run.start = stack[top].start;
+        }
+        run.power = power;
+        stack[top++] = run;
+        run = next;
+    }
+    while(top > 0)
+    {
+        top--;
+        run.head = merge_lists(stack[top].head, run.head, compare, &tail);
+    }
+    *head = run.head;
+}
+
+// Comparator used by compare_composite on the calling thread
+static _Thread_local const CompositeComparator* bound_comparator = NULL;
+
+typedef struct {
+    LinkedListNode** segments;
+    compare_fn compare;
+    const CompositeComparator* composite;
+    size_t stride;
+} ParallelSort;
+
+// Sorts one segment of a parallel sort with the caller's composite comparator bound on the worker
+static void sort_segment_task(void* ctx, size_t task)
+{
+    ParallelSort* sort = ctx;
+    const CompositeComparator* previous = bound_comparator;
+
+    bound_comparator = sort->composite;
+    mergesort(&sort->segments[task], sort->compare);
+    bound_comparator = previous;
+}
+
+// Merges segment 2 * task * stride with the segment stride after it, keeping the result in the first
+static void merge_segments_task(void* ctx, size_t task)
+{
+    ParallelSort* sort = ctx;
+    const CompositeComparator* previous = bound_comparator;
+    size_t left = 2 * task * sort->stride;
+
+    bound_comparator = sort->composite;
+    merge(&sort->segments[left], &sort->segments[left + sort->stride], sort->compare);
+    bound_comparator = previous;
+}
+
+// Sorts the list like mergesort using up to threads threads, or the number of online processors if threads is 0
+// The list is cut in one pass into four segments per thread, which are sorted concurrently by the worker pool so
+// segments with expensive comparisons are balanced by stealing, then merged pairwise in a tree of concurrent rounds
+// Segments are contiguous and merged in order, so the result is identical to the stable sequential sort
+// compare must be safe to call from several threads at once; the composite comparator bound on the calling thread is
+// bound on the workers too, so compare_composite sorts the same way as it would sequentially
+// The list is sorted on the calling thread if the segment array cannot be allocated
+void mergesort_parallel(LinkedListNode** head, compare_fn compare, unsigned int threads)
+{
+    ParallelSort sort;
+    LinkedListNode* node;
+    LinkedListNode* rest;
+    size_t n = 0;
+    size_t count, merges, i;
+
+    threads = resolve_threads(threads);
+    for(node = *head; node != NULL; node = node->next)
+        n++;
+    count = 4 * (size_t)threads;
+    if(threads == 1 || n < 2 * count)
+    {
+        mergesort(head, compare);
+        return;
+    }
+    sort.segments = malloc(count * sizeof(LinkedListNode*));
+    if(sort.segments == NULL)
+    {
+        mergesort(head, compare);
+        return;
+    }
+    sort.compare = compare;
+    sort.composite = bound_comparator;
+
+    rest = *head;
+    for(i = 0; i < count; i++)
+    {
+        sort.segments[i] = rest;
+        rest = cut_list(rest, n * (i + 1) / count - n * i / count);
+    }
+    parallel_tasks(count, threads, sort_segment_task, &sort);
+    for(sort.stride = 1; sort.stride < count; sort.stride *= 2)
+    {
+        merges = (count - sort.stride + 2 * sort.stride - 1) / (2 * sort.stride);
+        parallel_tasks(merges, threads, merge_segments_task, &sort);
+    }
+
+    *head = sort.segments[0];
+    free(sort.segments);
+}
+
+// Defines name(items, scratch, n, ctx), a stable bottom-up mergesort of n items of type using scratch, which must hold
+// n items; take_right(left, right, ctx) is true when the item at right must come before the one at left
+#define DEFINE_ARRAY_MERGESORT(name, type, ctx_type, take_right) \
+static void name(type* items, type* scratch, size_t n, ctx_type ctx) \
+{ \
+    type* src = items; \
+    type* dst = scratch; \
+    type* tmp; \
+    size_t width, start, mid, end, i, j, k; \
+ \
+    for(width = 1; width < n; width *= 2) \
+    { \
+        for(start = 0; start < n; start += 2 * width) \
+        { \
+            mid = (n - start > width) ? start + width : n; \
+            end = (n - mid > width) ? mid + width : n; \
+            for(i = start, j = mid, k = start; i < mid && j < end; k++) \
+                dst[k] = take_right(&src[i], &src[j], ctx) ? src[j++] : src[i++]; \
+            while(i < mid) \
+                dst[k++] = src[i++]; \
+            while(j < end) \
+                dst[k++] = src[j++]; \
+        } \
+        tmp = src; \
+        src = dst; \
+        dst = tmp; \
+    } \
+    if(src != items) \
+        memcpy(items, src, n * sizeof(type)); \
+}
+
+// A node gathered into an array with its object, so comparisons do not touch the node
+typedef struct {
+    Object* obj;
+    LinkedListNode* node;
+} GatheredNode;
+
+#define GATHERED_TAKE_RIGHT(left, right, ctx) ((ctx)((left)->obj, (right)->obj) > 0)
+DEFINE_ARRAY_MERGESORT(gathered_mergesort, GatheredNode, compare_fn, GATHERED_TAKE_RIGHT)
+#undef GATHERED_TAKE_RIGHT
+
+// Sorts the n node list by gathering its nodes into an array, sorting the array and relinking the nodes in one pass
+// Returns ERR_OUT_OF_MEMORY if the arrays could not be allocated, leaving the list unchanged, or 0 otherwise
+static int mergesort_gathered(LinkedListNode** head, compare_fn compare, size_t n)
+{
+    GatheredNode* nodes = malloc(2 * n * sizeof(GatheredNode));
+    LinkedListNode* node;
+    size_t i;
+
+    if(nodes == NULL)
+        return ERR_OUT_OF_MEMORY;
+    for(node = *head, i = 0; node != NULL; node = node->next, i++)
+    {
+        nodes[i].obj = node->obj;
+        nodes[i].node = node;
+    }
+    gathered_mergesort(nodes, nodes + n, n, compare);
+
+    for(i = 0; i + 1 < n; i++)
+        nodes[i].node->next = nodes[i + 1].node;
+    nodes[n - 1].node->next = NULL;
+    *head = nodes[0].node;
+    free(nodes);
+    return 0;
+}
+
+// Sorts the list like mergesort, choosing how by mode
+// SORT_MODE_IN_PLACE merges the list in place without allocating, SORT_MODE_GATHER sorts a contiguous array of the
+// nodes and relinks them, which avoids chasing scattered nodes on every merge pass, and SORT_MODE_AUTO gathers lists of
+// at least SORT_GATHER_THRESHOLD nodes; gathering falls back to sorting in place if the array cannot be allocated
+// Both ways give the same stable order
+void mergesort_with_mode(LinkedListNode** head, compare_fn compare, SortMode mode)
+{
+    LinkedListNode* node;
+    size_t n = 0;
+
+    if(mode != SORT_MODE_IN_PLACE)
+    {
+        for(node = *head; node != NULL; node = node->next)
+            n++;
+        if(n >= 2 && (mode == SORT_MODE_GATHER || n >= SORT_GATHER_THRESHOLD) &&
+           mergesort_gathered(head, compare, n) == 0)
+            return;
+    }
+    mergesort(head, compare);
+}
+
+// A key of a composite sort read from an object
+typedef union {
+    double price;
+    unsigned int quantity;
+    const char* name;
+} CompositeKey;
+
+// A node decorated with every key of a composite comparator
+typedef struct {
+    CompositeKey keys[COMPOSITE_KEY_MAX];
+    LinkedListNode* node;
+} CompositeKeyedNode;
+
+// Initializes a comparator ordering objects by keys[0], then keys[1] among objects with equal keys[0], and so on
+// Returns ERR_UNSUPPORTED_TYPE if count is 0, more than COMPOSITE_KEY_MAX, or a key has an unknown field, or 0 otherwise
+int composite_comparator_init(CompositeComparator* comparator, const SortKeySpec* keys, size_t count)
+{
+    size_t i;
+
+    if(count == 0 || count > COMPOSITE_KEY_MAX)
+        return ERR_UNSUPPORTED_TYPE;
+    for(i = 0; i < count; i++)
+    {
+        if(keys[i].field != SORT_KEY_PRICE && keys[i].field != SORT_KEY_QUANTITY && keys[i].field != SORT_KEY_NAME)
+            return ERR_UNSUPPORTED_TYPE;
+        comparator->keys[i] = keys[i];
+    }
+    comparator->count = count;
+    return 0;
+}
+
+// Binds the comparator used by compare_composite on the calling thread, the comparator must outlive the binding
+void composite_comparator_bind(const CompositeComparator* comparator)
+{
+    bound_comparator = comparator;
+}
+
+// Returns the key of obj for a field
+static CompositeKey composite_key(Object* obj, SortKeyField field)
+{
+    CompositeKey key;
+
+    if(field == SORT_KEY_PRICE)
+        key.price = object_price(obj);
+    else if(field == SORT_KEY_QUANTITY)
+        key.quantity = object_quantity(obj);
+    else
+        key.name = object_name(obj);
+    return key;
+}
+
+// Compares two keys of a field like compare_by_price, compare_by_quantity or strcmp, reversed if descending
+static int composite_key_compare(SortKeySpec spec, CompositeKey key1, CompositeKey key2)
+{
+    int result;
+
+    if(spec.field == SORT_KEY_PRICE)
+        result = (key1.price < key2.price) ? -1 : (key1.price > key2.price);
+    else if(spec.field == SORT_KEY_QUANTITY)
+        result = (key1.quantity < key2.quantity) ? -1 : (key1.quantity > key2.quantity);
+    else
+        result = strcmp(key1.name, key2.name);
+    return spec.descending ? -result : result;
+}
+
+// Compares obj1 with obj2 using the comparator bound on the calling thread, so it can be passed to mergesort, merge
+// and the other compare-based sorts; mergesort_parallel binds the caller's comparator on its workers
+// Keys are read in order and only until one differs, each at most once per object
+// Returns a negative number, 0 or a positive number like the other compare functions, or 0 if no comparator is bound
+// so sorting without one leaves the list in its order
+int compare_composite(Object* obj1, Object* obj2)
+{
+    const CompositeComparator* comparator = bound_comparator;
+    int result = 0;
+    size_t i;
+
+    if(comparator == NULL)
+        return 0;
+    for(i = 0; i < comparator->count && result == 0; i++)
+        result = composite_key_compare(comparator->keys[i], composite_key(obj1, comparator->keys[i].field),
+                                       composite_key(obj2, comparator->keys[i].field));
+    return result;
+}
+
+// Returns true when the decorated node right must come before left
+static bool composite_take_right(const CompositeKeyedNode* left, const CompositeKeyedNode* right,
+                                 const CompositeComparator* comparator)
+{
+    int result = 0;
+    size_t i;
+
+    for(i = 0; i < comparator->count && result == 0; i++)
+        result = composite_key_compare(comparator->keys[i], left->keys[i], right->keys[i]);
+    return result > 0;
+}
+
+DEFINE_ARRAY_MERGESORT(composite_mergesort, CompositeKeyedNode, const CompositeComparator*, composite_take_right)
+
+// Stably sorts the list by a composite comparator, reading every key of every object exactly once
+// Nodes are decorated with their keys in a contiguous array, sorted and relinked; if the array cannot be allocated the
+// list is sorted in place with mergesort and compare_composite, which reads keys once per comparison instead
+void mergesort_composite(LinkedListNode** head, const CompositeComparator* comparator)
+{
+    const CompositeComparator* previous = bound_comparator;
+    CompositeKeyedNode* nodes;
+    LinkedListNode* node;
+    size_t n = 0;
+    size_t i, k;
+
+    for(node = *head; node != NULL; node = node->next)
+        n++;
+    if(n < 2)
+        return;
+
+    nodes = malloc(2 * n * sizeof(CompositeKeyedNode));
+    if(nodes == NULL)
+    {
+        bound_comparator = comparator;
+        mergesort(head, compare_composite);
+        bound_comparator = previous;
+        return;
+    }
+    for(node = *head, i = 0; node != NULL; node = node->next, i++)
+    {
+        for(k = 0; k < comparator->count; k++)
+            nodes[i].keys[k] = composite_key(node->obj, comparator->keys[k].field);
+        nodes[i].node = node;
+    }
+    composite_mergesort(nodes, nodes + n, n, comparator);
+
+    for(i = 0; i + 1 < n; i++)
+        nodes[i].node->next = nodes[i + 1].node;
+    nodes[n - 1].node->next = NULL;
+    *head = nodes[0].node;
+    free(nodes);
+}
+
+// A node decorated with its sort key
+typedef struct {
+    uint64_t key;
+    LinkedListNode* node;
+} KeyedNode;
+
+// Returns an unsigned key that orders like x, with -0 and +0 equal
+// Negative numbers have all their bits flipped and other numbers have their sign bit set, so NaNs sort after +infinity,
+// or before -infinity if their sign bit is set
+uint64_t double_sort_key(double x)
+{
+    uint64_t bits = double_bits(x + 0.0);
+
+    return (bits >> 63) ? ~bits : bits | (1ull << 63);
+}
+
+#define KEYED_TAKE_RIGHT(left, right, ctx) ((right)->key < (left)->key)
+DEFINE_ARRAY_MERGESORT(keyed_mergesort, KeyedNode, const void*, KEYED_TAKE_RIGHT)
+#undef KEYED_TAKE_RIGHT
+
+// Sorts the decorated nodes and relinks the list in their order
+// Returns ERR_OUT_OF_MEMORY if the scratch array could not be allocated, leaving the list unchanged, or 0 otherwise
+static int keyed_relink(LinkedListNode** head, KeyedNode* nodes, size_t n)
+{
+    KeyedNode* scratch = malloc(n * sizeof(KeyedNode));
+    size_t i;
+
+    if(scratch == NULL)
+        return ERR_OUT_OF_MEMORY;
+    keyed_mergesort(nodes, scratch, n, NULL);
+    free(scratch);
+
+    for(i = 0; i + 1 < n; i++)
+        nodes[i].node->next = nodes[i + 1].node;
+    nodes[n - 1].node->next = NULL;
+    *head = nodes[0].node;
+    return 0;
+}
+
+// Decorates every node of the list with its key, using the double key function if key is not NULL and the integer
+// one otherwise, then sorts and relinks it
+static int mergesort_decorated(LinkedListNode** head, key_fn key, key_u64_fn key_u64)
+{
+    KeyedNode* nodes;
+    LinkedListNode* node;
+    size_t n = 0;
+    int result;
+
+    for(node = *head; node != NULL; node = node->next)
+        n++;
+    if(n < 2)
+        return 0;
+
+    nodes = malloc(n * sizeof(KeyedNode));
+    if(nodes == NULL)
+        return ERR_OUT_OF_MEMORY;
+    for(node = *head, n = 0; node != NULL; node = node->next, n++)
+    {
+        nodes[n].key = (key != NULL) ? double_sort_key(key(node->obj)) : key_u64(node->obj);
+        nodes[n].node = node;
+    }
+    result = keyed_relink(head, nodes, n);
+    free(nodes);
+    return result;
+}
+
+// Stably sorts the list in increasing order of key, calling key exactly once per node
+// Passing object_price sorts like mergesort with compare_by_price without pricing objects on every comparison
+// Keys are ordered as by double_sort_key
+// Returns ERR_OUT_OF_MEMORY if the keys could not be allocated, leaving the list unchanged, or 0 otherwise
+int mergesort_by_key(LinkedListNode** head, key_fn key)
+{
+    return mergesort_decorated(head, key, NULL);
+}
+
+// Stably sorts the list in increasing order of an integer key, calling key exactly once per node
+// Returns ERR_OUT_OF_MEMORY if the keys could not be allocated, leaving the list unchanged, or 0 otherwise
+int mergesort_by_key_u64(LinkedListNode** head, key_u64_fn key)
+{
+    return mergesort_decorated(head, NULL, key);
+}
+
+// Stably sorts the list in increasing order of an integer key with an LSD radix sort on bytes, calling key exactly
+// once per node
+// The nodes are decorated with their keys like mergesort_by_key_u64, a first pass histograms every byte of every key,
+// and only byte positions where keys differ get a counting pass between the array and a scratch array
+// Returns ERR_OUT_OF_MEMORY if the keys could not be allocated, leaving the list unchanged, or 0 otherwise
+int radix_sort_by_key_u64(LinkedListNode** head, key_u64_fn key)
+{
+    size_t counts[8][256];
+    KeyedNode* nodes;
+    KeyedNode* scratch;
+    KeyedNode* swap;
+    LinkedListNode* node;
+    uint64_t first;
+    size_t offset, count, n = 0;
+    size_t i;
+    unsigned int byte, b;
+
+    for(node = *head; node != NULL; node = node->next)
+        n++;
+    if(n < 2)
+        return 0;
+
+    nodes = malloc(2 * n * sizeof(KeyedNode));
+    if(nodes == NULL)
+        return ERR_OUT_OF_MEMORY;
+    scratch = nodes + n;
+
+    memset(counts, 0, sizeof(counts));
+    for(node = *head, i = 0; node != NULL; node = node->next, i++)
+    {
+        nodes[i].key = key(node->obj);
+        nodes[i].node = node;
+        for(byte = 0; byte < 8; byte++)
+            counts[byte][(nodes[i].key >> (8 * byte)) & 0xff]++;
+    }
+
+    first = nodes[0].key;
+    for(byte = 0; byte < 8; byte++)
+    {
+        // All keys share this byte, a pass would not move anything
+        if(counts[byte][(first >> (8 * byte)) & 0xff] == n)
+            continue;
+
+        for(b = 0, offset = 0; b < 256; b++)
+        {
+            count = counts[byte][b];
+            counts[byte][b] = offset;
+            offset += count;
+        }
+        for(i = 0; i < n; i++)
+            scratch[counts[byte][(nodes[i].key >> (8 * byte)) & 0xff]++] = nodes[i];
+        swap = nodes;
+        nodes = scratch;
+        scratch = swap;
+    }
+
+    for(i = 0; i + 1 < n; i++)
+        nodes[i].node->next = nodes[i + 1].node;
+    nodes[n - 1].node->next = NULL;
+    *head = nodes[0].node;
+    free((nodes < scratch) ? nodes : scratch);
+    return 0;
+}
+
+static uint64_t quantity_sort_key(Object* obj)
+{
+    return object_quantity(obj);
+}
+
+static uint64_t price_sort_key(Object* obj)
+{
+    return double_sort_key(object_price(obj));
+}
+
+// Stably sorts the list in increasing order of quantity, in the same order as mergesort with compare_by_quantity
+// Quantities are unsigned ints so at most 4 distribution passes are made
+// Returns ERR_OUT_OF_MEMORY if the keys could not be allocated, leaving the list unchanged, or 0 otherwise
+int radix_sort_by_quantity(LinkedListNode** head)
+{
+    return radix_sort_by_key_u64(head, quantity_sort_key);
+}
+
+// Stably sorts the list in increasing order of price, in the same order as mergesort with compare_by_price
+// Every object is priced once
+// Returns ERR_OUT_OF_MEMORY if the keys could not be allocated, leaving the list unchanged, or 0 otherwise
+int radix_sort_by_price(LinkedListNode** head)
+{
+    return radix_sort_by_key_u64(head, price_sort_key);
+}
+
+//
+// Unrolled list functions
+//
+
+// Initializes an iterator to the beginning of an unrolled list
+// An unrolled list stores up to UNROLLED_BLOCK_CAPACITY objects per block so a traversal touches one block per several
+// objects instead of one node per object; the list allocates its own blocks and never keeps an empty one
+void unrolled_iterator_begin(UnrolledIterator* iter, UnrolledBlock** head)
+{
+    iter->prev_next = head;
+    iter->prev = NULL;
+    iter->block = *head;
+    iter->index = 0;
+}
+
+// Returns true if iterator is at the end of the list or false otherwise
+bool unrolled_iterator_at_end(UnrolledIterator* iter)
+{
+    return iter->block == NULL;
+}
+
+// Advances the iterator to the next object in the list
+void unrolled_iterator_next(UnrolledIterator* iter)
+{
+    if(iter->block == NULL)
+        return;
+    if(++iter->index == iter->block->count)
+    {
+        iter->prev_next = &iter->block->next;
+        iter->prev = iter->block;
+        iter->block = iter->block->next;
+        iter->index = 0;
+    }
+}
+
+// Returns the object referenced by the iterator or NULL if at the end of the list
+Object* unrolled_iterator_get_object(UnrolledIterator* iter)
+{
+    return (iter->block != NULL) ? iter->block->objs[iter->index] : NULL;
+}
+
+// Moves the upper half of a full block into a new block after it
+// Returns false if the new block could not be allocated
+static bool unrolled_split(UnrolledBlock* block)
+{
+    UnrolledBlock* upper = malloc(sizeof(UnrolledBlock));
+    unsigned int half = UNROLLED_BLOCK_CAPACITY / 2;
+
+    if(upper == NULL)
+        return false;
+    upper->count = UNROLLED_BLOCK_CAPACITY - half;
+    memcpy(upper->objs, &block->objs[half], upper->count * sizeof(Object*));
+    upper->next = block->next;
+    block->next = upper;
+    block->count = half;
+    return true;
+}
+
+// Makes room in the iterator's block by splitting it if it is full, moving the iterator along with its object
+// Returns false if the block could not be split
+static bool unrolled_make_room(UnrolledIterator* iter)
+{
+    UnrolledBlock* block = iter->block;
+
+    if(block->count < UNROLLED_BLOCK_CAPACITY)
+        return true;
+    if(unrolled_split(block) == false)
+        return false;
+    if(iter->index >= block->count)
+    {
+        iter->index -= block->count;
+        iter->prev_next = &block->next;
+        iter->prev = block;
+        iter->block = block->next;
+    }
+    return true;
+}
+
+// Inserts obj at position index of a block that has room
+static void unrolled_insert_at(UnrolledBlock* block, unsigned int index, Object* obj)
+{
+    memmove(&block->objs[index + 1], &block->objs[index], (block->count - index) * sizeof(Object*));
+    block->objs[index] = obj;
+    block->count++;
+}
+
+// Removes the object referenced by the iterator from the list and returns it
+// The iterator is valid after call and references the next object; blocks less than half full absorb the next block
+// when it fits, and emptied blocks are freed
+// Returns NULL if the iterator is at the end of the list
+Object* unrolled_iterator_remove(UnrolledIterator* iter)
+{
+    UnrolledBlock* block = iter->block;
+    UnrolledBlock* next;
+    Object* obj;
+
+    if(block == NULL)
+        return NULL;
+    obj = block->objs[iter->index];
+    block->count--;
+    memmove(&block->objs[iter->index], &block->objs[iter->index + 1], (block->count - iter->index) * sizeof(Object*));
+
+    next = block->next;
+    if(next != NULL && block->count < UNROLLED_BLOCK_CAPACITY / 2 &&
+       block->count + next->count <= UNROLLED_BLOCK_CAPACITY)
+    {
+        memcpy(&block->objs[block->count], next->objs, next->count * sizeof(Object*));
+        block->count += next->count;
+        block->next = next->next;
+        free(next);
+    }
+    if(block->count == 0)
+    {
+        *iter->prev_next = block->next;
+        iter->block = block->next;
+        free(block);
+    }
+    else if(iter->index == block->count)
+    {
+        iter->prev_next = &block->next;
+        iter->prev = block;
+        iter->block = block->next;
+        iter->index = 0;
+    }
+    return obj;
+}
+
+// Inserts obj after the current object referenced by the iterator
+// The iterator is valid after call and references the same object as before
+// Returns ERR_INSERT_AFTER_END error if iterator at the end of the list, ERR_OUT_OF_MEMORY if a block could not be
+// allocated, or 0 otherwise
+int unrolled_iterator_insert_after(UnrolledIterator* iter, Object* obj)
+{
+    if(iter->block == NULL)
+        return ERR_INSERT_AFTER_END;
+    if(unrolled_make_room(iter) == false)
+        return ERR_OUT_OF_MEMORY;
+    unrolled_insert_at(iter->block, iter->index + 1, obj);
+    return 0;
+}
+
+// Inserts obj before the current object referenced by the iterator, or at the end of the list if the iterator is there
+// The iterator is valid after call and references the same object as before
+// Returns ERR_OUT_OF_MEMORY if a block could not be allocated or 0 otherwise
+int unrolled_iterator_insert_before(UnrolledIterator* iter, Object* obj)
+{
+    UnrolledBlock* block;
+
+    if(iter->block != NULL)
+    {
+        if(unrolled_make_room(iter) == false)
+            return ERR_OUT_OF_MEMORY;
+        unrolled_insert_at(iter->block, iter->index, obj);
+        iter->index++;
+        return 0;
+    }
+
+    // At the end, append to the last block if it has room or start a new one
+    block = iter->prev;
+    if(block != NULL && block->count < UNROLLED_BLOCK_CAPACITY)
+    {
+        block->objs[block->count++] = obj;
+        return 0;
+    }
+    block = malloc(sizeof(UnrolledBlock));
+    if(block == NULL)
+        return ERR_OUT_OF_MEMORY;
+    block->next = NULL;
+    block->count = 1;
+    block->objs[0] = obj;
+    *iter->prev_next = block;
+    iter->prev_next = &block->next;
+    iter->prev = block;
+    return 0;
+}
+
+// Frees every block of the list and leaves it empty, the objects are owned by the caller
+void unrolled_destroy(UnrolledBlock** head)
+{
+    UnrolledBlock* block;
+    UnrolledBlock* next;
+
+    for(block = *head; block != NULL; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+    *head = NULL;
+}
+
+// Returns the number of objects in the list
+int unrolled_length(UnrolledBlock** head)
+{
+    UnrolledBlock* block;
+    int counter = 0;
+
+    for(block = *head; block != NULL; block = block->next)
+        counter += (int)block->count;
+    return counter;
+}
+
+// Executes the func function for each object in the list like foreach
+Data unrolled_foreach(UnrolledBlock** head, foreach_fn func, Data data)
+{
+    UnrolledBlock* block;
+    unsigned int i;
+
+    for(block = *head; block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+            data = func(block->objs[i], data);
+    }
+    return data;
+}
+
+// Returns the maximum, minimum, and average price of the list like max_min_avg_price, pricing each block in one batch
+// All three are 0 for an empty list
+void unrolled_max_min_avg_price(UnrolledBlock** head, double* max, double* min, double* avg)
+{
+    double prices[UNROLLED_BLOCK_CAPACITY];
+    UnrolledBlock* block;
+    double sum = 0;
+    size_t count = 0;
+    unsigned int i;
+
+    *max = -INFINITY;
+    *min = INFINITY;
+    for(block = *head; block != NULL; block = block->next)
+    {
+        object_price_batch(block->objs, block->count, prices);
+        for(i = 0; i < block->count; i++)
+        {
+            if(prices[i] > *max)
+                *max = prices[i];
+            if(prices[i] < *min)
+                *min = prices[i];
+            sum += prices[i];
+        }
+        count += block->count;
+    }
+    if(count == 0)
+    {
+        *max = 0;
+        *min = 0;
+        *avg = 0;
+        return;
+    }
+    *avg = sum / (double)count;
+}
+
+#define OBJECT_TAKE_RIGHT(left, right, ctx) ((ctx)(*(left), *(right)) > 0)
+DEFINE_ARRAY_MERGESORT(object_mergesort, Object*, compare_fn, OBJECT_TAKE_RIGHT)
+#undef OBJECT_TAKE_RIGHT
+
+// Stably sorts the list like mergesort by gathering its objects into an array, sorting it and writing the objects back
+// into the same blocks
+// Returns ERR_OUT_OF_MEMORY if the array could not be allocated, leaving the list unchanged, or 0 otherwise
+int unrolled_mergesort(UnrolledBlock** head, compare_fn compare)
+{
+    UnrolledBlock* block;
+    Object** objs;
+    size_t n = (size_t)unrolled_length(head);
+    size_t i = 0;
+
+    if(n < 2)
+        return 0;
+    objs = malloc(2 * n * sizeof(Object*));
+    if(objs == NULL)
+        return ERR_OUT_OF_MEMORY;
+    for(block = *head; block != NULL; block = block->next)
+    {
+        memcpy(&objs[i], block->objs, block->count * sizeof(Object*));
+        i += block->count;
+    }
+    object_mergesort(objs, objs + n, n, compare);
+    for(block = *head, i = 0; block != NULL; block = block->next)
+    {
+        memcpy(block->objs, &objs[i], block->count * sizeof(Object*));
+        i += block->count;
+    }
+    free(objs);
+    return 0;
+}
+
+//
+// Price index functions
+//
+
+// Initializes an empty price index
+// A price index keeps the list at head sorted by price, with equal prices in insertion order, and layers skip-list
+// towers over its nodes so inserts, removes and lookups take O(log n) expected time
+// Every node has a tower on level 0 caching its price, so searches never price list nodes, and about a quarter of
+// them reach each further level
+// head stays a plain sorted list that foreach, length and the iterators can walk; nodes are owned by the caller and the
+// prices of indexed objects must not change while they are indexed
+void price_index_init(PriceIndex* index)
+{
+    memset(index, 0, sizeof(*index));
+    index->seed = 2463534242u;
+}
+
+// Frees the towers of the index and empties it, the nodes of the list are left linked
+void price_index_destroy(PriceIndex* index)
+{
+    SkipTower* tower;
+    SkipTower* next;
+
+    for(tower = index->heads[0]; tower != NULL; tower = next)
+    {
+        next = tower->next[0];
+        free(tower);
+    }
+    price_index_init(index);
+}
+
+// Returns a random tower height, 1 with probability 3/4 and each further level with probability 1/4
+static unsigned int price_index_height(PriceIndex* index)
+{
+    unsigned int height = 1;
+    unsigned int bits;
+
+    // xorshift32
+    index->seed ^= index->seed << 13;
+    index->seed ^= index->seed >> 17;
+    index->seed ^= index->seed << 5;
+    for(bits = index->seed; (bits & 3) == 0 && height < PRICE_INDEX_MAX_LEVEL; bits >>= 2)
+        height++;
+    return height;
+}
+
+// Finds the last tower on each level whose price is below price, or at most price if inclusive, storing it in
+// update, NULL standing for the level head
+// Returns the tower following the one found on level 0, or NULL if there is none
+static SkipTower* price_index_search(PriceIndex* index, double price, bool inclusive, SkipTower** update)
+{
+    SkipTower* tower = NULL;
+    SkipTower* next;
+    unsigned int level = index->levels;
+
+    while(level-- > 0)
+    {
+        next = (tower != NULL) ? tower->next[level] : index->heads[level];
+        while(next != NULL && (next->price < price || (inclusive && next->price == price)))
+        {
+            tower = next;
+            next = tower->next[level];
+        }
+        update[level] = tower;
+    }
+    return (tower != NULL) ? tower->next[0] : index->heads[0];
+}
+
+// Inserts node into the list after every node with a lower or equal price, in O(log n) expected time
+// Returns ERR_OUT_OF_MEMORY if the tower of the node cannot be allocated, leaving the node out of the list, or 0
+// otherwise
+int price_index_insert(PriceIndex* index, LinkedListNode* node)
+{
+    SkipTower* update[PRICE_INDEX_MAX_LEVEL];
+    SkipTower* tower;
+    double price = object_price(node->obj);
+    unsigned int height = price_index_height(index);
+    unsigned int level;
+
+    tower = malloc(sizeof(SkipTower) + height * sizeof(SkipTower*));
+    if(tower == NULL)
+        return ERR_OUT_OF_MEMORY;
+    tower->node = node;
+    tower->price = price;
+    tower->height = height;
+    price_index_search(index, price, true, update);
+    for(; index->levels < height; index->levels++)
+        update[index->levels] = NULL;
+
+    // The tower before it on level 0 is over the list node before it
+    if(update[0] != NULL)
+    {
+        node->next = update[0]->node->next;
+        update[0]->node->next = node;
+    }
+    else
+    {
+        node->next = index->head;
+        index->head = node;
+    }
+    for(level = 0; level < height; level++)
+    {
+        if(update[level] != NULL)
+        {
+            tower->next[level] = update[level]->next[level];
+            update[level]->next[level] = tower;
+        }
+        else
+        {
+            tower->next[level] = index->heads[level];
+            index->heads[level] = tower;
+        }
+    }
+    return 0;
+}
+
+// Removes node from the list and its tower from the index, in O(log n) expected time plus the number of nodes with the
+// same price, which are told apart by identity
+// Returns false if the node is not in the index
+bool price_index_remove(PriceIndex* index, LinkedListNode* node)
+{
+    SkipTower* update[PRICE_INDEX_MAX_LEVEL];
+    SkipTower* tower = NULL;
+    SkipTower* prev;
+    SkipTower* curr;
+    double price = object_price(node->obj);
+    unsigned int level;
+
+    price_index_search(index, price, false, update);
+    // The tower of the node is among the towers of equal price on each level it reaches, starting with level 0
+    for(level = 0; level < index->levels; level++)
+    {
+        prev = update[level];
+        curr = (prev != NULL) ? prev->next[level] : index->heads[level];
+        while(curr != NULL && curr->price == price && curr->node != node)
+        {
+            prev = curr;
+            curr = curr->next[level];
+        }
+        if(curr == NULL || curr->node != node)
+            break;
+        if(prev != NULL)
+            prev->next[level] = curr->next[level];
+        else
+            index->heads[level] = curr->next[level];
+        if(level == 0)
+        {
+            if(prev != NULL)
+                prev->node->next = node->next;
+            else
+                index->head = node->next;
+        }
+        tower = curr;
+    }
+    if(tower == NULL)
+        return false;
+    free(tower);
+    while(index->levels > 0 && index->heads[index->levels - 1] == NULL)
+        index->levels--;
+    return true;
+}
+
+// Returns the tower over the first node whose price is at least price, or NULL if there is none
+static SkipTower* price_index_lower_tower(PriceIndex* index, double price)
+{
+    SkipTower* update[PRICE_INDEX_MAX_LEVEL];
+
+    return price_index_search(index, price, false, update);
+}
+
+// Returns the first node whose price is at least price, or NULL if there is none
+LinkedListNode* price_index_lower_bound(PriceIndex* index, double price)
+{
+    SkipTower* tower = price_index_lower_tower(index, price);
+
+    return (tower != NULL) ? tower->node : NULL;
+}
+
+// Returns the first inserted object with exactly the given price, or NULL if there is none
+Object* price_index_find(PriceIndex* index, double price)
+{
+    SkipTower* tower = price_index_lower_tower(index, price);
+
+    return (tower != NULL && tower->price == price) ? tower->node->obj : NULL;
+}
+
+// Initializes an iterator over the objects of the index with prices in [low, high], in price order
+void price_range_begin(PriceRangeIterator* iter, PriceIndex* index, double low, double high)
+{
+    SkipTower* tower = price_index_lower_tower(index, low);
+
+    iter->curr = (tower != NULL && tower->price <= high) ? tower->node : NULL;
+    iter->high = high;
+}
+
+// Returns true if the iterator is past the last object of its range or false otherwise
+bool price_range_at_end(PriceRangeIterator* iter)
+{
+    return iter->curr == NULL;
+}
+
+// Advances the iterator to the next object of its range
+void price_range_next(PriceRangeIterator* iter)
+{
+    if(iter->curr == NULL)
+        return;
+    iter->curr = iter->curr->next;
+    if(iter->curr != NULL && object_price(iter->curr->obj) > iter->high)
+        iter->curr = NULL;
+}
+
+// Returns the object referenced by the iterator or NULL if at the end of its range
+Object* price_range_get_object(PriceRangeIterator* iter)
+{
+    return (iter->curr != NULL) ? iter->curr->obj : NULL;
 }
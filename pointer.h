@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
 
 //
 // Constants
@@ -11,7 +15,27 @@
 
 static const double ERR_OUT_OF_STOCK = -1.0;
 static const int ERR_INSERT_AFTER_END = -2;
+static const int ERR_OUT_OF_MEMORY = -3;
+static const int ERR_UNSUPPORTED_TYPE = -4;
+static const int ERR_PRICE_NOT_FOUND = -5;
+static const int ERR_INVALID_ARGUMENT = -6;
 static const double BULK_DISCOUNT = 0.9;
+#define BULK_PRICE_LOOP_MAX 64u
+static const unsigned int POWER_SUM_EM_START = 32;
+#define PRICE_BATCH_CHUNK 256
+#define BULK_QUOTE_INLINE_MAX 256
+#define BULK_QUOTE_TASK_SIZE 16
+#define COMPOSITE_KEY_MAX 4
+#define FOREACH_BATCH_MAX 256
+#define UNROLLED_BLOCK_CAPACITY 14
+#define ARENA_CLASS_COUNT 16
+#define PRICE_INDEX_MAX_LEVEL 24
+static const size_t ARENA_CLASS_SIZE = 16;
+static const size_t ARENA_SLAB_SIZE = 256 * 1024;
+static const size_t ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+static const size_t PRICE_SUMMARY_BLOCK = 4096;
+static const size_t FOREACH_PARALLEL_BLOCK = 4096;
+static const size_t SORT_GATHER_THRESHOLD = 256;
 
 //
 // Structure definitions and function pointer typedefs
@@ -20,12 +44,36 @@ static const double BULK_DISCOUNT = 0.9;
 typedef double (*price_fn)(void* obj);
 typedef double (*bulk_price_fn)(void* obj, unsigned int quantity);
 
+typedef enum {
+    OBJECT_TYPE_OTHER,
+    OBJECT_TYPE_STATIC,
+    OBJECT_TYPE_DYNAMIC
+} ObjectType;
+
+// Tags object_price and object_bulk_price switch on with POINTER_TAGGED_DISPATCH, the first three are the ObjectType
+// values and dynamic objects with factor-specialized price functions are tagged with their specialization
+typedef enum {
+    OBJECT_DISPATCH_OTHER = OBJECT_TYPE_OTHER,
+    OBJECT_DISPATCH_STATIC = OBJECT_TYPE_STATIC,
+    OBJECT_DISPATCH_DYNAMIC = OBJECT_TYPE_DYNAMIC,
+    OBJECT_DISPATCH_DYNAMIC_CONSTANT,
+    OBJECT_DISPATCH_DYNAMIC_SQRT,
+    OBJECT_DISPATCH_DYNAMIC_LINEAR,
+    OBJECT_DISPATCH_DYNAMIC_SQUARE
+} ObjectDispatch;
+
+// Building with POINTER_TAGGED_DISPATCH adds an ObjectDispatch tag to Object that object_price and object_bulk_price
+// switch on, calling the static and dynamic price functions directly and only using virtual_func_table for
+// OBJECT_TYPE_OTHER
 typedef struct {
     struct {
         price_fn price;
         bulk_price_fn bulk_price;
     } virtual_func_table;
     unsigned int quantity;
+#ifdef POINTER_TAGGED_DISPATCH
+    unsigned char type;
+#endif
     const char* name;
 } Object;
 
@@ -34,22 +82,130 @@ typedef struct {
     double price;
 } StaticPriceObject;
 
+typedef struct {
+    bool price_valid;
+    bool bulk_valid;
+    unsigned int price_quantity;
+    unsigned int bulk_stock;
+    unsigned int bulk_quantity;
+    double price;
+    double bulk_price;
+    unsigned long hits;
+    unsigned long misses;
+} PriceMemo;
+
 typedef struct {
     Object obj;
     double base;
     double factor;
 } DynamicPriceObject;
 
+// A DynamicPriceObject that memoizes its price and bulk price, kept apart so plain objects do not carry the memo
+typedef struct {
+    DynamicPriceObject dynamic;
+    PriceMemo memo;
+} MemoDynamicPriceObject;
+
+typedef struct {
+    DynamicPriceObject* obj;
+    double base;
+    double factor;
+    unsigned int max_quantity;
+    double* prefix;
+} PriceCurve;
+
 typedef struct LinkedListNode_s {
     Object* obj;
     struct LinkedListNode_s* next;
 } LinkedListNode;
 
+typedef struct PriceTreeNode_s {
+    double price;
+    unsigned long count;
+    unsigned int priority;
+    struct PriceTreeNode_s* child[2];
+} PriceTreeNode;
+
+typedef struct {
+    PriceTreeNode* root;
+    unsigned long count;
+    double sum;
+    double compensation;
+    unsigned int seed;
+    int error;
+} PriceAggregate;
+
 typedef struct {
     LinkedListNode** prev_next;
     LinkedListNode* curr;
 } LinkedListIterator;
 
+// An iterator that prefetches the objects of the nodes some distance ahead of the current one
+// It is read and changed through its iter member like a plain iterator, but moved with prefetch_iterator_next
+typedef struct {
+    LinkedListIterator iter;
+    LinkedListNode* ahead;
+} PrefetchListIterator;
+
+// An iterator whose insertions and removals through the tracked_iterator functions are mirrored in a PriceAggregate
+// The aggregate holds each object's price as of its insertion, so prices of tracked objects may only change through
+// tracked_iterator_set_quantity or with price_aggregate_update, otherwise removing the object later reports
+// ERR_PRICE_NOT_FOUND until the aggregate is reattached
+typedef struct {
+    LinkedListIterator iter;
+    PriceAggregate* aggregate;
+} TrackedListIterator;
+
+typedef struct ArenaFree_s {
+    struct ArenaFree_s* next;
+} ArenaFree;
+
+// Slabs shared by the caches of an arena, created with arena_create
+typedef struct Arena_s Arena;
+
+typedef struct {
+    Arena* arena;
+    unsigned long generation;
+    char* cursor;
+    char* limit;
+    ArenaFree* free[ARENA_CLASS_COUNT];
+} ArenaCache;
+
+// A block of an unrolled list, holding count objects; the capacity fills two cache lines
+typedef struct UnrolledBlock_s {
+    struct UnrolledBlock_s* next;
+    unsigned int count;
+    Object* objs[UNROLLED_BLOCK_CAPACITY];
+} UnrolledBlock;
+
+typedef struct {
+    UnrolledBlock** prev_next;
+    UnrolledBlock* prev;
+    UnrolledBlock* block;
+    unsigned int index;
+} UnrolledIterator;
+
+// Skip-list tower over one node of a price index, caching its price; next[level] links the towers of each level in
+// price order
+typedef struct SkipTower_s {
+    LinkedListNode* node;
+    double price;
+    unsigned int height;
+    struct SkipTower_s* next[];
+} SkipTower;
+
+typedef struct {
+    LinkedListNode* head;
+    SkipTower* heads[PRICE_INDEX_MAX_LEVEL];
+    unsigned int levels;
+    unsigned int seed;
+} PriceIndex;
+
+typedef struct {
+    LinkedListNode* curr;
+    double high;
+} PriceRangeIterator;
+
 typedef union {
     void* ptr;
     int i;
@@ -59,21 +215,168 @@ typedef union {
 } Data;
 
 typedef Data (*foreach_fn)(Object* obj, Data data);
+typedef Data (*foreach_batch_fn)(Object** objs, size_t n, Data data);
+typedef Data (*map_fn)(Object* obj);
+typedef Data (*combine_fn)(Data left, Data right);
 typedef int (*compare_fn)(Object* obj1, Object* obj2);
+// How mergesort_with_mode sorts a list
+typedef enum {
+    SORT_MODE_AUTO,
+    SORT_MODE_IN_PLACE,
+    SORT_MODE_GATHER
+} SortMode;
+
+// Object fields a composite comparator can order by
+typedef enum {
+    SORT_KEY_PRICE,
+    SORT_KEY_QUANTITY,
+    SORT_KEY_NAME
+} SortKeyField;
+
+typedef struct {
+    SortKeyField field;
+    bool descending;
+} SortKeySpec;
+
+typedef struct {
+    size_t count;
+    SortKeySpec keys[COMPOSITE_KEY_MAX];
+} CompositeComparator;
+
+typedef double (*key_fn)(Object* obj);
+typedef uint64_t (*key_u64_fn)(Object* obj);
+
+// Aggregates a ListQuery can compute, combined as a bitmask
+enum {
+    LIST_QUERY_COUNT = 1 << 0,
+    LIST_QUERY_PRICE_MIN = 1 << 1,
+    LIST_QUERY_PRICE_MAX = 1 << 2,
+    LIST_QUERY_PRICE_SUM = 1 << 3,
+    LIST_QUERY_QUANTITY_SUM = 1 << 4,
+    LIST_QUERY_FOLD = 1 << 5,
+    LIST_QUERY_TOP = 1 << 6
+};
+
+typedef struct {
+    unsigned int aggregates;
+    foreach_fn fold;
+    size_t top_capacity;
+    Object** top_objs;
+    double* top_prices;
+    size_t count;
+    double price_min;
+    double price_max;
+    double price_sum;
+    unsigned long quantity_sum;
+    Data fold_data;
+    size_t top_count;
+} ListQuery;
+
+typedef struct {
+    size_t length;
+    size_t capacity;
+    unsigned int* quantity;
+    unsigned char* type;
+    double* price;
+    double* base;
+    double* factor;
+    unsigned int* name_id;
+    const char** names;
+    size_t name_count;
+    size_t name_capacity;
+    unsigned int* name_slots;
+    size_t name_slot_count;
+} InventoryTable;
+
+typedef union {
+    Object obj;
+    StaticPriceObject static_obj;
+    DynamicPriceObject dynamic_obj;
+} InventoryRecord;
+
+typedef Data (*inventory_foreach_fn)(InventoryTable* table, size_t row, Data data);
 
 //
 // Object functions
 //
 
+double static_price(StaticPriceObject* obj);
+
+double dynamic_price(DynamicPriceObject* obj);
+
+double static_bulk_price(StaticPriceObject* obj, unsigned int quantity);
+
+double dynamic_bulk_price(DynamicPriceObject* obj, unsigned int quantity);
+
+double dynamic_price_constant(DynamicPriceObject* obj);
+
+double dynamic_price_sqrt(DynamicPriceObject* obj);
+
+double dynamic_price_linear(DynamicPriceObject* obj);
+
+double dynamic_price_square(DynamicPriceObject* obj);
+
+double dynamic_bulk_price_polynomial(DynamicPriceObject* obj, unsigned int quantity);
+
+double dynamic_bulk_price_sqrt(DynamicPriceObject* obj, unsigned int quantity);
+
+// Sets the type tag object_price and object_bulk_price dispatch on when built with POINTER_TAGGED_DISPATCH
+// Objects with user-defined price functions that are not zero-initialized must be tagged OBJECT_TYPE_OTHER
+static inline void object_set_dispatch(Object* obj, ObjectType type)
+{
+#ifdef POINTER_TAGGED_DISPATCH
+    obj->type = (unsigned char)type;
+#else
+    (void)obj;
+    (void)type;
+#endif
+}
+
 // Returns the price of an object
 static inline double object_price(Object* obj)
 {
+#ifdef POINTER_TAGGED_DISPATCH
+    switch(obj->type)
+    {
+    case OBJECT_DISPATCH_STATIC:
+        return static_price((StaticPriceObject*)obj);
+    case OBJECT_DISPATCH_DYNAMIC:
+        return dynamic_price((DynamicPriceObject*)obj);
+    case OBJECT_DISPATCH_DYNAMIC_CONSTANT:
+        return dynamic_price_constant((DynamicPriceObject*)obj);
+    case OBJECT_DISPATCH_DYNAMIC_SQRT:
+        return dynamic_price_sqrt((DynamicPriceObject*)obj);
+    case OBJECT_DISPATCH_DYNAMIC_LINEAR:
+        return dynamic_price_linear((DynamicPriceObject*)obj);
+    case OBJECT_DISPATCH_DYNAMIC_SQUARE:
+        return dynamic_price_square((DynamicPriceObject*)obj);
+    default:
+        break;
+    }
+#endif
     return obj->virtual_func_table.price(obj);
 }
 
 // Returns the bulk price of an object
 static inline double object_bulk_price(Object* obj, unsigned int quantity)
 {
+#ifdef POINTER_TAGGED_DISPATCH
+    switch(obj->type)
+    {
+    case OBJECT_DISPATCH_STATIC:
+        return static_bulk_price((StaticPriceObject*)obj, quantity);
+    case OBJECT_DISPATCH_DYNAMIC:
+        return dynamic_bulk_price((DynamicPriceObject*)obj, quantity);
+    case OBJECT_DISPATCH_DYNAMIC_CONSTANT:
+    case OBJECT_DISPATCH_DYNAMIC_LINEAR:
+    case OBJECT_DISPATCH_DYNAMIC_SQUARE:
+        return dynamic_bulk_price_polynomial((DynamicPriceObject*)obj, quantity);
+    case OBJECT_DISPATCH_DYNAMIC_SQRT:
+        return dynamic_bulk_price_sqrt((DynamicPriceObject*)obj, quantity);
+    default:
+        break;
+    }
+#endif
     return obj->virtual_func_table.bulk_price(obj, quantity);
 }
 
@@ -95,6 +398,19 @@ static inline void object_print(Object* obj)
     printf("%s ($%.2f): %u\n", object_name(obj), object_price(obj), object_quantity(obj));
 }
 
+ObjectType object_type(Object* obj);
+
+void object_price_batch(Object** objs, size_t n, double* out);
+
+void price_power(const double* quantity, const double* factor, double* out, size_t n);
+
+void object_bulk_price_parallel(Object** objs, const unsigned int* quantities, size_t n, double* out, unsigned int threads);
+
+// The _parallel functions share one pool of helper threads, started on first use; calls from different threads are
+// serialized, each waiting for the running one to finish
+// Joins the helper threads, a later parallel call starts them again
+void parallel_shutdown(void);
+
 int compare_by_price(Object* obj1, Object* obj2);
 
 int compare_by_quantity(Object* obj1, Object* obj2);
@@ -103,13 +419,40 @@ void static_price_object_construct(StaticPriceObject* obj, unsigned int quantity
 
 void dynamic_price_object_construct(DynamicPriceObject* obj, unsigned int quantity, const char* name, double base, double factor);
 
-double static_price(StaticPriceObject* obj);
+void memo_dynamic_price_object_construct(MemoDynamicPriceObject* obj, unsigned int quantity, const char* name, double base, double factor);
 
-double dynamic_price(DynamicPriceObject* obj);
+void dynamic_price_object_set_price(DynamicPriceObject* obj, double base, double factor);
 
-double static_bulk_price(StaticPriceObject* obj, unsigned int quantity);
+double memo_dynamic_price(MemoDynamicPriceObject* obj);
 
-double dynamic_bulk_price(DynamicPriceObject* obj, unsigned int quantity);
+double memo_dynamic_bulk_price(MemoDynamicPriceObject* obj, unsigned int quantity);
+
+// Drops the memoized prices of a MemoDynamicPriceObject
+// Quantity changes do not need this since the memoized prices are keyed on quantity
+static inline void memo_dynamic_price_object_invalidate(MemoDynamicPriceObject* obj)
+{
+    obj->memo.price_valid = false;
+    obj->memo.bulk_valid = false;
+}
+
+// Returns the fraction of memoized price lookups of a MemoDynamicPriceObject that were cache hits
+static inline double memo_dynamic_price_hit_rate(MemoDynamicPriceObject* obj)
+{
+    unsigned long lookups = obj->memo.hits + obj->memo.misses;
+    return (lookups == 0) ? 0 : (double)obj->memo.hits / (double)lookups;
+}
+
+//
+// Price curve functions
+//
+
+int price_curve_build(PriceCurve* curve, DynamicPriceObject* obj, unsigned int max_quantity);
+
+void price_curve_destroy(PriceCurve* curve);
+
+double price_curve_bulk_price(PriceCurve* curve, unsigned int quantity);
+
+void price_curve_ladder(PriceCurve* curve, double* out, unsigned int max_quantity);
 
 //
 // Iterator functions
@@ -117,6 +460,14 @@ double dynamic_bulk_price(DynamicPriceObject* obj, unsigned int quantity);
 
 void iterator_begin(LinkedListIterator* iter, LinkedListNode** head);
 
+void iterator_begin_tracked(TrackedListIterator* iter, LinkedListNode** head, PriceAggregate* aggregate);
+
+void iterator_begin_prefetch(PrefetchListIterator* iter, LinkedListNode** head, unsigned int distance);
+
+void prefetch_iterator_next(PrefetchListIterator* iter);
+
+void list_set_prefetch_distance(unsigned int distance);
+
 void iterator_next(LinkedListIterator* iter);
 
 bool iterator_at_end(LinkedListIterator* iter);
@@ -129,16 +480,112 @@ int iterator_insert_after(LinkedListIterator* iter, LinkedListNode* node);
 
 void iterator_insert_before(LinkedListIterator* iter, LinkedListNode* node);
 
+int tracked_iterator_remove(TrackedListIterator* iter, LinkedListNode** node);
+
+int tracked_iterator_insert_after(TrackedListIterator* iter, LinkedListNode* node);
+
+int tracked_iterator_insert_before(TrackedListIterator* iter, LinkedListNode* node);
+
+int tracked_iterator_set_quantity(TrackedListIterator* iter, unsigned int quantity);
+
 //
 // List functions
 //
 
 void max_min_avg_price(LinkedListNode** head, double* max, double* min, double* avg);
 
+int max_min_avg_price_parallel(LinkedListNode** head, double* max, double* min, double* avg, unsigned int threads);
+
 Data foreach(LinkedListNode** head, foreach_fn func, Data data);
 
+Data foreach_batch(LinkedListNode** head, foreach_batch_fn func, Data data, size_t batch);
+
+Data foreach_parallel(LinkedListNode** head, map_fn map, combine_fn combine, Data identity, unsigned int threads,
+                      bool deterministic);
+
 int length(LinkedListNode** head);
 
+//
+// List query functions
+//
+
+void list_query_init(ListQuery* query, unsigned int aggregates);
+
+void list_query_set_fold(ListQuery* query, foreach_fn func, Data data);
+
+void list_query_set_top(ListQuery* query, size_t n, Object** objs, double* prices);
+
+void list_query_run(ListQuery* query, LinkedListNode** head);
+
+//
+// Price aggregate functions
+//
+
+void price_aggregate_init(PriceAggregate* aggregate);
+
+void price_aggregate_destroy(PriceAggregate* aggregate);
+
+int price_aggregate_attach(PriceAggregate* aggregate, LinkedListNode** head);
+
+int price_aggregate_add(PriceAggregate* aggregate, double price);
+
+int price_aggregate_remove(PriceAggregate* aggregate, double price);
+
+int price_aggregate_update(PriceAggregate* aggregate, double old_price, double new_price);
+
+int price_aggregate_max_min_avg(PriceAggregate* aggregate, double* max, double* min, double* avg);
+
+//
+// Arena functions
+//
+
+Arena* arena_create(size_t slab_size, bool huge_pages);
+
+void arena_reset(Arena* arena);
+
+void arena_destroy(Arena* arena);
+
+void arena_cache_init(ArenaCache* cache, Arena* arena);
+
+void* arena_alloc(ArenaCache* cache, size_t size);
+
+void arena_free(ArenaCache* cache, void* ptr, size_t size);
+
+LinkedListNode* arena_new_node(ArenaCache* cache, Object* obj);
+
+StaticPriceObject* arena_new_static_price_object(ArenaCache* cache, unsigned int quantity, const char* name, double price);
+
+DynamicPriceObject* arena_new_dynamic_price_object(ArenaCache* cache, unsigned int quantity, const char* name, double base,
+                                                   double factor);
+
+//
+// Inventory table functions
+//
+
+void inventory_table_init(InventoryTable* table);
+
+void inventory_table_destroy(InventoryTable* table);
+
+int inventory_table_append(InventoryTable* table, Object* obj);
+
+int inventory_table_remove(InventoryTable* table, size_t row);
+
+int inventory_table_import(InventoryTable* table, LinkedListNode** head);
+
+// Names are interned, so exported objects point to the name of the first appended object with an equal name rather
+// than to the name of the object their row was appended from
+void inventory_table_export(InventoryTable* table, LinkedListNode* nodes, InventoryRecord* records, LinkedListNode** head);
+
+double inventory_table_price(InventoryTable* table, size_t row);
+
+const char* inventory_table_name(InventoryTable* table, size_t row);
+
+int inventory_table_length(InventoryTable* table);
+
+void inventory_table_max_min_avg_price(InventoryTable* table, double* max, double* min, double* avg);
+
+Data inventory_table_foreach(InventoryTable* table, inventory_foreach_fn func, Data data);
+
 //
 // Mergesort
 //
@@ -149,4 +596,82 @@ void split(LinkedListNode** head, LinkedListNode** split_head);
 
 void mergesort(LinkedListNode** head, compare_fn compare);
 
+void mergesort_natural(LinkedListNode** head, compare_fn compare);
+
+void mergesort_parallel(LinkedListNode** head, compare_fn compare, unsigned int threads);
+
+void mergesort_with_mode(LinkedListNode** head, compare_fn compare, SortMode mode);
+
+int composite_comparator_init(CompositeComparator* comparator, const SortKeySpec* keys, size_t count);
+
+void composite_comparator_bind(const CompositeComparator* comparator);
+
+int compare_composite(Object* obj1, Object* obj2);
+
+void mergesort_composite(LinkedListNode** head, const CompositeComparator* comparator);
+
+int mergesort_by_key(LinkedListNode** head, key_fn key);
+
+int mergesort_by_key_u64(LinkedListNode** head, key_u64_fn key);
+
+uint64_t double_sort_key(double x);
+
+int radix_sort_by_key_u64(LinkedListNode** head, key_u64_fn key);
+
+int radix_sort_by_quantity(LinkedListNode** head);
+
+int radix_sort_by_price(LinkedListNode** head);
+
+//
+// Unrolled list functions
+//
+
+void unrolled_iterator_begin(UnrolledIterator* iter, UnrolledBlock** head);
+
+bool unrolled_iterator_at_end(UnrolledIterator* iter);
+
+void unrolled_iterator_next(UnrolledIterator* iter);
+
+Object* unrolled_iterator_get_object(UnrolledIterator* iter);
+
+Object* unrolled_iterator_remove(UnrolledIterator* iter);
+
+int unrolled_iterator_insert_after(UnrolledIterator* iter, Object* obj);
+
+int unrolled_iterator_insert_before(UnrolledIterator* iter, Object* obj);
+
+void unrolled_destroy(UnrolledBlock** head);
+
+int unrolled_length(UnrolledBlock** head);
+
+Data unrolled_foreach(UnrolledBlock** head, foreach_fn func, Data data);
+
+void unrolled_max_min_avg_price(UnrolledBlock** head, double* max, double* min, double* avg);
+
+int unrolled_mergesort(UnrolledBlock** head, compare_fn compare);
+
+//
+// Price index functions
+//
+
+void price_index_init(PriceIndex* index);
+
+void price_index_destroy(PriceIndex* index);
+
+int price_index_insert(PriceIndex* index, LinkedListNode* node);
+
+bool price_index_remove(PriceIndex* index, LinkedListNode* node);
+
+LinkedListNode* price_index_lower_bound(PriceIndex* index, double price);
+
+Object* price_index_find(PriceIndex* index, double price);
+
+void price_range_begin(PriceRangeIterator* iter, PriceIndex* index, double low, double high);
+
+bool price_range_at_end(PriceRangeIterator* iter);
+
+void price_range_next(PriceRangeIterator* iter);
+
+Object* price_range_get_object(PriceRangeIterator* iter);
+
 #endif // POINTER_H
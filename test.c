@@ -8,6 +8,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <pthread.h>
 
 int tests_run = 0;
 #define mu_str_(text) #text
@@ -116,6 +117,46 @@ char* test_polymorphism()
     return NULL;
 }
 
+static double custom_price(void* obj) {
+    return (double)((Object*)obj)->quantity * 0.25;
+}
+
+char* test_object_price_batch()
+{
+    StaticPriceObject static_objs[300];
+    DynamicPriceObject dynamic_objs[300];
+    Object custom;
+    Object* objs[601];
+    double out[601];
+    const double factors[] = {0, 0.5, 1, 2, -0.5, 1.7};
+    size_t n = 0;
+    for (unsigned int i = 0; i < 300; i++) {
+        static_price_object_construct(&static_objs[i], i % 5, "static", 1.5 + i);
+        dynamic_price_object_construct(&dynamic_objs[i], i % 7, "dynamic", 0.75 * i, factors[i % 6]);
+        objs[n++] = (i % 3 == 0) ? &static_objs[i].obj : &dynamic_objs[i].obj;
+        objs[n++] = (i % 3 == 0) ? &dynamic_objs[i].obj : &static_objs[i].obj;
+    }
+    custom.virtual_func_table.price = custom_price;
+    object_set_dispatch(&custom, OBJECT_TYPE_OTHER);
+    custom.quantity = 6;
+    objs[n++] = &custom;
+    mu_assert("test_object_price_batch: Testing object types are detected",
+              object_type(&static_objs[0].obj) == OBJECT_TYPE_STATIC &&
+              object_type(&dynamic_objs[0].obj) == OBJECT_TYPE_DYNAMIC &&
+              object_type(&custom) == OBJECT_TYPE_OTHER);
+    object_price_batch(objs, n, out);
+    for (size_t i = 0; i < n; i++) {
+        mu_assert("test_object_price_batch: Testing batch price matches object_price",
+                  out[i] == object_price(objs[i]));
+    }
+    mu_assert("test_object_price_batch: Testing out of stock price",
+              out[0] == ERR_OUT_OF_STOCK && out[1] == ERR_OUT_OF_STOCK);
+    mu_assert("test_object_price_batch: Testing user-defined price",
+              approx_equal(out[600], 1.5));
+    object_price_batch(objs, 0, out);
+    return NULL;
+}
+
 char* test_compare_by_quantity()
 {
     StaticPriceObject obj1;
@@ -221,6 +262,264 @@ char* test_dynamic_bulk_price()
     return NULL;
 }
 
+static double reference_dynamic_bulk_price(DynamicPriceObject* obj, unsigned int quantity) {
+    long double total = 0;
+    for (unsigned int k = 1; k < quantity; k++) {
+        total += powl((long double)k, (long double)obj->factor);
+    }
+    return (double)(total * (long double)obj->base * (long double)BULK_DISCOUNT) + dynamic_price(obj);
+}
+
+static int relative_equal(double val1, double val2) {
+    return fabs(val1 - val2) <= 1e-12 * fmax(fabs(val1), fabs(val2)) || approx_equal(val1, val2);
+}
+
+char* test_dynamic_bulk_price_large()
+{
+    DynamicPriceObject obj;
+    const double factors[] = {0, 1, 2, 3, 4, -1, -2, 0.5, -0.5, 1.5, -1.000001, 2.7, -3.3};
+    const unsigned int quantities[] = {65, 66, 100, 1000, 123457};
+    for (size_t i = 0; i < sizeof(factors)/sizeof(factors[0]); i++) {
+        for (size_t j = 0; j < sizeof(quantities)/sizeof(quantities[0]); j++) {
+            dynamic_price_object_construct(&obj, 200000, "test_obj1", 1.25, factors[i]);
+            mu_assert("test_dynamic_bulk_price_large: Testing large bulk price matches the per-item sum",
+                      relative_equal(dynamic_bulk_price(&obj, quantities[j]),
+                                     reference_dynamic_bulk_price(&obj, quantities[j])));
+        }
+    }
+    dynamic_price_object_construct(&obj, 1000, "test_obj2", 0.5, 0);
+    mu_assert("test_dynamic_bulk_price_large: Testing bulk price is calculated appropriately",
+              approx_equal(dynamic_bulk_price(&obj, 1000), 0.5 + 0.45 * 999));
+    mu_assert("test_dynamic_bulk_price_large: Testing out of stock bulk price",
+              dynamic_bulk_price(&obj, 1001) == ERR_OUT_OF_STOCK);
+    return NULL;
+}
+
+char* test_dynamic_price_memo()
+{
+    MemoDynamicPriceObject obj;
+    DynamicPriceObject plain;
+    double price;
+    memo_dynamic_price_object_construct(&obj, 4, "test_obj1", 7.0, -0.5);
+    dynamic_price_object_construct(&plain, 16, "test_obj2", 7.0, -0.5);
+    mu_assert("test_dynamic_price_memo: Testing memoized object is priced through its own functions",
+              object_type(&obj.dynamic.obj) == OBJECT_TYPE_OTHER);
+    mu_assert("test_dynamic_price_memo: Testing plain objects do not carry the memo",
+              sizeof(DynamicPriceObject) < sizeof(MemoDynamicPriceObject));
+    price = object_price(&obj.dynamic.obj);
+    mu_assert("test_dynamic_price_memo: Testing memoized price is correct",
+              price == dynamic_price(&obj.dynamic) && approx_equal(price, 3.5));
+    mu_assert("test_dynamic_price_memo: Testing memoized price is reused",
+              object_price(&obj.dynamic.obj) == price && obj.memo.hits == 1 && obj.memo.misses == 1);
+    obj.dynamic.obj.quantity = 16;
+    mu_assert("test_dynamic_price_memo: Testing quantity change invalidates the price",
+              approx_equal(object_price(&obj.dynamic.obj), 1.75) && obj.memo.misses == 2);
+    mu_assert("test_dynamic_price_memo: Testing memoized bulk price is correct",
+              object_bulk_price(&obj.dynamic.obj, 3) == dynamic_bulk_price(&plain, 3));
+    mu_assert("test_dynamic_price_memo: Testing a bulk price miss counts as one lookup",
+              obj.memo.hits == 1 && obj.memo.misses == 3);
+    mu_assert("test_dynamic_price_memo: Testing memoized bulk price is reused",
+              object_bulk_price(&obj.dynamic.obj, 3) == dynamic_bulk_price(&plain, 3) && obj.memo.hits == 2);
+    mu_assert("test_dynamic_price_memo: Testing bulk price for a new quantity",
+              object_bulk_price(&obj.dynamic.obj, 2) == dynamic_bulk_price(&plain, 2));
+    mu_assert("test_dynamic_price_memo: Testing out of stock bulk price",
+              object_bulk_price(&obj.dynamic.obj, 17) == ERR_OUT_OF_STOCK);
+    dynamic_price_object_set_price(&obj.dynamic, 2.0, 1.0);
+    mu_assert("test_dynamic_price_memo: Testing price change keeps the memo",
+              obj.dynamic.obj.virtual_func_table.price == (price_fn)memo_dynamic_price);
+    mu_assert("test_dynamic_price_memo: Testing price change invalidates the price",
+              approx_equal(object_price(&obj.dynamic.obj), 32.0));
+    mu_assert("test_dynamic_price_memo: Testing hit rate",
+              approx_equal(memo_dynamic_price_hit_rate(&obj), (double)obj.memo.hits / (double)(obj.memo.hits + obj.memo.misses)));
+    Object* batch[2] = {&obj.dynamic.obj, &obj.dynamic.obj};
+    double batch_prices[2];
+    unsigned long hits = obj.memo.hits;
+    object_price_batch(batch, 2, batch_prices);
+    mu_assert("test_dynamic_price_memo: Testing batch pricing uses the memo",
+              obj.memo.hits == hits + 2 && approx_equal(batch_prices[1], 32.0));
+    return NULL;
+}
+
+char* test_dynamic_price_specialized()
+{
+    DynamicPriceObject obj;
+    const double factors[] = {0, 0.5, 1, 2, 1.5};
+    const price_fn prices[] = {(price_fn)dynamic_price_constant, (price_fn)dynamic_price_sqrt,
+                               (price_fn)dynamic_price_linear, (price_fn)dynamic_price_square,
+                               (price_fn)dynamic_price};
+    const unsigned int quantities[] = {0, 1, 2, 5, 64, 65, 66, 1000};
+#ifdef POINTER_TAGGED_DISPATCH
+    const ObjectDispatch tags[] = {OBJECT_DISPATCH_DYNAMIC_CONSTANT, OBJECT_DISPATCH_DYNAMIC_SQRT,
+                                   OBJECT_DISPATCH_DYNAMIC_LINEAR, OBJECT_DISPATCH_DYNAMIC_SQUARE,
+                                   OBJECT_DISPATCH_DYNAMIC};
+#endif
+    for (size_t i = 0; i < sizeof(factors)/sizeof(factors[0]); i++) {
+        dynamic_price_object_construct(&obj, 1000, "test_obj1", 1.99, factors[i]);
+        mu_assert("test_dynamic_price_specialized: Testing specialized price function is installed",
+                  obj.obj.virtual_func_table.price == prices[i]);
+#ifdef POINTER_TAGGED_DISPATCH
+        mu_assert("test_dynamic_price_specialized: Testing tagged dispatch uses the specialized function",
+                  obj.obj.type == tags[i]);
+#endif
+        mu_assert("test_dynamic_price_specialized: Testing specialized price matches dynamic_price",
+                  object_price(&obj.obj) == dynamic_price(&obj));
+        for (size_t j = 0; j < sizeof(quantities)/sizeof(quantities[0]); j++) {
+            mu_assert("test_dynamic_price_specialized: Testing specialized bulk price matches dynamic_bulk_price",
+                      relative_equal(object_bulk_price(&obj.obj, quantities[j]), dynamic_bulk_price(&obj, quantities[j])));
+        }
+        mu_assert("test_dynamic_price_specialized: Testing out of stock bulk price",
+                  object_bulk_price(&obj.obj, 1001) == ERR_OUT_OF_STOCK);
+        obj.obj.quantity = 0;
+        mu_assert("test_dynamic_price_specialized: Testing out of stock price",
+                  object_price(&obj.obj) == ERR_OUT_OF_STOCK);
+    }
+    dynamic_price_object_construct(&obj, 3, "test_obj2", 2.0, 1.5);
+    dynamic_price_object_set_price(&obj, 2.0, 2);
+    mu_assert("test_dynamic_price_specialized: Testing set_price installs the specialized function",
+              obj.obj.virtual_func_table.price == (price_fn)dynamic_price_square &&
+              approx_equal(object_price(&obj.obj), 18.0));
+    return NULL;
+}
+
+char* test_price_power()
+{
+    double quantity[1000];
+    double factor[1000];
+    double out[1000];
+    DynamicPriceObject obj;
+    const double factors[] = {0, 0.5, 1, 2, -0.5, -2.0, 1.5, 3.25, -1.75};
+    size_t n = 0;
+    for (size_t i = 0; i < sizeof(factors)/sizeof(factors[0]); i++) {
+        for (unsigned int q = 1; q <= 111; q++) {
+            quantity[n] = (double)(q * q * q);
+            factor[n] = factors[i];
+            n++;
+        }
+    }
+    price_power(quantity, factor, out, n);
+    for (size_t i = 0; i < n; i++) {
+        dynamic_price_object_construct(&obj, (unsigned int)quantity[i], "test_obj1", 1.0, factor[i]);
+        mu_assert("test_price_power: Testing kernel matches dynamic_price",
+                  fabs(out[i] - dynamic_price(&obj)) <= 1e-13 * dynamic_price(&obj));
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (factor[i] == 0 || factor[i] == 1 || factor[i] == 2 || factor[i] == 0.5) {
+            mu_assert("test_price_power: Testing exact factors",
+                      out[i] == pow(quantity[i], factor[i]) || out[i] == sqrt(quantity[i]));
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    Object** objs;
+    const unsigned int* quantities;
+    double out[1000];
+} BulkQuoteCaller;
+
+static void* bulk_quote_caller(void* arg)
+{
+    BulkQuoteCaller* caller = arg;
+    for (unsigned int round = 0; round < 20; round++) {
+        object_bulk_price_parallel(caller->objs, caller->quantities, 1000, caller->out, 4);
+    }
+    return NULL;
+}
+
+char* test_bulk_price_parallel()
+{
+    StaticPriceObject static_objs[100];
+    DynamicPriceObject dynamic_objs[100];
+    Object* objs[1000];
+    unsigned int quantities[1000];
+    double out[1000];
+    const double factors[] = {0, 0.5, 1, 2, -0.5, 1.7};
+    for (unsigned int i = 0; i < 100; i++) {
+        static_price_object_construct(&static_objs[i], 1000 * i, "static", 1.5 + i);
+        dynamic_price_object_construct(&dynamic_objs[i], 100000 * i, "dynamic", 0.75, factors[i % 6]);
+    }
+    for (unsigned int i = 0; i < 1000; i++) {
+        objs[i] = (i % 2) ? &static_objs[i % 100].obj : &dynamic_objs[i % 100].obj;
+        quantities[i] = (i % 10 == 0) ? 99999 * (i % 100) : i;
+    }
+    quantities[5] = 1000000;
+    for (unsigned int threads = 0; threads <= 4; threads++) {
+        memset(out, 0, sizeof(out));
+        object_bulk_price_parallel(objs, quantities, 1000, out, threads);
+        for (size_t i = 0; i < 1000; i++) {
+            mu_assert("test_bulk_price_parallel: Testing parallel quote matches object_bulk_price",
+                      out[i] == object_bulk_price(objs[i], quantities[i]));
+        }
+    }
+    memset(out, 0, sizeof(out));
+    object_bulk_price_parallel(objs, quantities, 10, out, 4);
+    mu_assert("test_bulk_price_parallel: Testing small batch",
+              out[9] == object_bulk_price(objs[9], quantities[9]) && out[10] == 0);
+    mu_assert("test_bulk_price_parallel: Testing out of stock quote",
+              out[5] == ERR_OUT_OF_STOCK);
+    object_bulk_price_parallel(objs, quantities, 0, out, 4);
+
+    // Jobs from several threads share the pool one after the other
+    BulkQuoteCaller callers[4];
+    pthread_t handles[4];
+    for (size_t c = 0; c < 4; c++) {
+        callers[c].objs = objs;
+        callers[c].quantities = quantities;
+        mu_assert("test_bulk_price_parallel: Testing caller thread starts",
+                  pthread_create(&handles[c], NULL, bulk_quote_caller, &callers[c]) == 0);
+    }
+    for (size_t c = 0; c < 4; c++) {
+        pthread_join(handles[c], NULL);
+    }
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t i = 0; i < 1000; i++) {
+            mu_assert("test_bulk_price_parallel: Testing concurrent callers get their own quotes",
+                      callers[c].out[i] == object_bulk_price(objs[i], quantities[i]));
+        }
+    }
+
+    // The pool starts again after a shutdown
+    parallel_shutdown();
+    parallel_shutdown();
+    memset(out, 0, sizeof(out));
+    object_bulk_price_parallel(objs, quantities, 1000, out, 4);
+    for (size_t i = 0; i < 1000; i++) {
+        mu_assert("test_bulk_price_parallel: Testing quote after shutdown",
+                  out[i] == object_bulk_price(objs[i], quantities[i]));
+    }
+    parallel_shutdown();
+    return NULL;
+}
+
+char* test_price_curve()
+{
+    DynamicPriceObject obj;
+    PriceCurve curve;
+    double ladder[1201];
+    dynamic_price_object_construct(&obj, 1100, "test_obj1", 1.99, -0.5);
+    mu_assert("test_price_curve: Testing curve is built",
+              price_curve_build(&curve, &obj, 1000) == 0);
+    for (unsigned int q = 0; q <= 1100; q += 7) {
+        mu_assert("test_price_curve: Testing curve matches dynamic_bulk_price",
+                  relative_equal(price_curve_bulk_price(&curve, q), dynamic_bulk_price(&obj, q)));
+    }
+    price_curve_ladder(&curve, ladder, 1200);
+    for (unsigned int q = 0; q <= 1200; q++) {
+        mu_assert("test_price_curve: Testing ladder matches dynamic_bulk_price",
+                  relative_equal(ladder[q], dynamic_bulk_price(&obj, q)));
+    }
+    mu_assert("test_price_curve: Testing out of stock ladder entry",
+              ladder[1101] == ERR_OUT_OF_STOCK);
+    dynamic_price_object_set_price(&obj, 0.5, 1.5);
+    mu_assert("test_price_curve: Testing curve is rebuilt after a price change",
+              relative_equal(price_curve_bulk_price(&curve, 500), dynamic_bulk_price(&obj, 500)));
+    obj.obj.quantity = 10;
+    mu_assert("test_price_curve: Testing out of stock bulk price",
+              price_curve_bulk_price(&curve, 11) == ERR_OUT_OF_STOCK);
+    price_curve_destroy(&curve);
+    return NULL;
+}
+
 char* test_iterator_basic()
 {
     Object obj3;
@@ -284,6 +583,37 @@ char* test_iterator_basic()
     return NULL;
 }
 
+char* test_iterator_prefetch()
+{
+    Object objs[10];
+    LinkedListNode nodes[10];
+    LinkedListNode* head = &nodes[0];
+    PrefetchListIterator iter;
+    for (unsigned int i = 0; i < 10; i++) {
+        nodes[i].obj = &objs[i];
+        nodes[i].next = (i + 1 < 10) ? &nodes[i + 1] : NULL;
+    }
+    for (unsigned int distance = 0; distance <= 12; distance += 3) {
+        unsigned int i = 0;
+        iterator_begin_prefetch(&iter, &head, distance);
+        while (!iterator_at_end(&iter.iter)) {
+            mu_assert("test_iterator_prefetch: Testing prefetching iterator visits every node in order",
+                      iterator_get_object(&iter.iter) == &objs[i++]);
+            prefetch_iterator_next(&iter);
+        }
+        mu_assert("test_iterator_prefetch: Testing prefetching iterator reaches the end",
+                  i == 10 && iterator_get_object(&iter.iter) == NULL);
+    }
+    iterator_begin_prefetch(&iter, &head, 4);
+    prefetch_iterator_next(&iter);
+    mu_assert("test_iterator_prefetch: Testing remove while prefetching",
+              iterator_remove(&iter.iter) == &nodes[1] && iterator_get_object(&iter.iter) == &objs[2]);
+    iterator_insert_before(&iter.iter, &nodes[1]);
+    mu_assert("test_iterator_prefetch: Testing insert while prefetching",
+              iterator_get_object(&iter.iter) == &objs[2] && nodes[0].next == &nodes[1] && length(&head) == 10);
+    return NULL;
+}
+
 char* test_iterator_remove()
 {
     Object obj5;
@@ -500,6 +830,133 @@ char* test_max_min_avg_price()
     return NULL;
 }
 
+char* test_max_min_avg_price_parallel()
+{
+    static StaticPriceObject static_objs[10000];
+    static DynamicPriceObject dynamic_objs[10000];
+    static LinkedListNode nodes[20000];
+    LinkedListNode* head = NULL;
+    double max, min, avg, list_max, list_min, list_avg;
+    double first_avg = 0;
+    for (unsigned int i = 0; i < 10000; i++) {
+        static_price_object_construct(&static_objs[i], 1, "static", 0.1 * (i % 977));
+        dynamic_price_object_construct(&dynamic_objs[i], 1 + i % 50, "dynamic", 1e6 / (1 + i), 0.5);
+        nodes[2 * i].obj = &static_objs[i].obj;
+        nodes[2 * i + 1].obj = &dynamic_objs[i].obj;
+    }
+    for (unsigned int i = 0; i < 20000; i++) {
+        nodes[i].next = (i + 1 < 20000) ? &nodes[i + 1] : NULL;
+    }
+    mu_assert("test_max_min_avg_price_parallel: Testing empty list",
+              max_min_avg_price_parallel(&head, &max, &min, &avg, 4) == 0 && max == 0 && avg == 0);
+    head = &nodes[0];
+    max_min_avg_price(&head, &list_max, &list_min, &list_avg);
+    for (unsigned int threads = 0; threads <= 5; threads++) {
+        mu_assert("test_max_min_avg_price_parallel: Testing success",
+                  max_min_avg_price_parallel(&head, &max, &min, &avg, threads) == 0);
+        mu_assert("test_max_min_avg_price_parallel: Testing max and min match max_min_avg_price",
+                  max == list_max && min == list_min);
+        mu_assert("test_max_min_avg_price_parallel: Testing avg matches max_min_avg_price",
+                  relative_equal(avg, list_avg));
+        if (threads == 0) {
+            first_avg = avg;
+        }
+        mu_assert("test_max_min_avg_price_parallel: Testing avg is identical for any thread count",
+                  memcmp(&avg, &first_avg, sizeof(avg)) == 0);
+    }
+    return NULL;
+}
+
+char* test_price_aggregate()
+{
+    StaticPriceObject objs[50];
+    LinkedListNode nodes[50];
+    LinkedListNode* head = NULL;
+    TrackedListIterator iter;
+    LinkedListNode* removed;
+    PriceAggregate aggregate;
+    double max, min, avg, list_max, list_min, list_avg;
+    for (unsigned int i = 0; i < 50; i++) {
+        static_price_object_construct(&objs[i], 1 + i % 3, "obj", (double)((i * 7) % 13));
+        nodes[i].obj = &objs[i].obj;
+        nodes[i].next = NULL;
+    }
+    price_aggregate_init(&aggregate);
+    mu_assert("test_price_aggregate: Testing empty aggregate",
+              price_aggregate_max_min_avg(&aggregate, &max, &min, &avg) == 0 && max == 0 && avg == 0);
+    mu_assert("test_price_aggregate: Testing attach",
+              price_aggregate_attach(&aggregate, &head) == 0);
+    iterator_begin_tracked(&iter, &head, &aggregate);
+    for (unsigned int i = 0; i < 40; i++) {
+        if (i % 2) {
+            mu_assert("test_price_aggregate: Testing tracked insert before",
+                      tracked_iterator_insert_before(&iter, &nodes[i]) == 0);
+        } else if (tracked_iterator_insert_after(&iter, &nodes[i]) != 0) {
+            mu_assert("test_price_aggregate: Testing tracked insert at the end",
+                      tracked_iterator_insert_before(&iter, &nodes[i]) == 0);
+        }
+    }
+    mu_assert("test_price_aggregate: Testing count after inserts",
+              aggregate.count == 40 && length(&head) == 40);
+    iterator_begin_tracked(&iter, &head, &aggregate);
+    while (!iterator_at_end(&iter.iter)) {
+        if (object_price(iterator_get_object(&iter.iter)) >= 11) {
+            mu_assert("test_price_aggregate: Testing tracked remove",
+                      tracked_iterator_remove(&iter, &removed) == 0);
+        } else {
+            iterator_next(&iter.iter);
+        }
+    }
+    max_min_avg_price(&head, &list_max, &list_min, &list_avg);
+    price_aggregate_max_min_avg(&aggregate, &max, &min, &avg);
+    mu_assert("test_price_aggregate: Testing max matches max_min_avg_price",
+              max == list_max && max == 10);
+    mu_assert("test_price_aggregate: Testing min matches max_min_avg_price",
+              min == list_min && min == 0);
+    mu_assert("test_price_aggregate: Testing avg matches max_min_avg_price",
+              approx_equal(avg, list_avg));
+    mu_assert("test_price_aggregate: Testing count matches length",
+              aggregate.count == (unsigned long)length(&head));
+    price_aggregate_attach(&aggregate, &head);
+    price_aggregate_max_min_avg(&aggregate, &max, &min, &avg);
+    mu_assert("test_price_aggregate: Testing reattach",
+              max == list_max && min == list_min && approx_equal(avg, list_avg));
+
+    // A dynamic price follows the quantity, so a tracked quantity change moves the object to its new price
+    DynamicPriceObject dynamic_obj;
+    LinkedListNode dynamic_node;
+    double old_price;
+    dynamic_price_object_construct(&dynamic_obj, 4, "dynamic", 30.0, -0.5);
+    dynamic_node.obj = &dynamic_obj.obj;
+    iterator_begin_tracked(&iter, &head, &aggregate);
+    tracked_iterator_insert_before(&iter, &dynamic_node);
+    old_price = object_price(&dynamic_obj.obj);
+    iterator_begin_tracked(&iter, &head, &aggregate);
+    mu_assert("test_price_aggregate: Testing tracked quantity change",
+              iterator_get_object(&iter.iter) == &dynamic_obj.obj && tracked_iterator_set_quantity(&iter, 25) == 0);
+    mu_assert("test_price_aggregate: Testing price update",
+              price_aggregate_update(&aggregate, object_price(&dynamic_obj.obj), 3.0) == 0);
+    dynamic_obj.obj.quantity = 100;
+    max_min_avg_price(&head, &list_max, &list_min, &list_avg);
+    price_aggregate_max_min_avg(&aggregate, &max, &min, &avg);
+    mu_assert("test_price_aggregate: Testing update matches max_min_avg_price",
+              max == list_max && min == list_min && approx_equal(avg, list_avg) && max == 10);
+    mu_assert("test_price_aggregate: Testing removing a price that was never added",
+              price_aggregate_remove(&aggregate, old_price) == ERR_PRICE_NOT_FOUND &&
+              price_aggregate_max_min_avg(&aggregate, &max, &min, &avg) == ERR_PRICE_NOT_FOUND);
+    mu_assert("test_price_aggregate: Testing updating a price that was never added",
+              price_aggregate_update(&aggregate, old_price, 1.0) == ERR_PRICE_NOT_FOUND);
+    dynamic_obj.obj.quantity = 4;
+    iterator_begin_tracked(&iter, &head, &aggregate);
+    mu_assert("test_price_aggregate: Testing tracked remove of a price that changed in place",
+              tracked_iterator_remove(&iter, &removed) == ERR_PRICE_NOT_FOUND && removed == &dynamic_node);
+    mu_assert("test_price_aggregate: Testing reattach clears the error",
+              price_aggregate_attach(&aggregate, &head) == 0 &&
+              price_aggregate_max_min_avg(&aggregate, &max, &min, &avg) == 0 && max == 10);
+    price_aggregate_destroy(&aggregate);
+    return NULL;
+}
+
 static Data gather(Object* obj, Data data) {
     double* price = (double*)data.ptr;
     *price = object_price(obj);
@@ -533,6 +990,220 @@ char* test_foreach()
     return NULL;
 }
 
+char* test_list_query()
+{
+    StaticPriceObject static_objs[300];
+    DynamicPriceObject dynamic_objs[300];
+    LinkedListNode nodes[600];
+    LinkedListNode* head = NULL;
+    Object* top_objs[5];
+    double top_prices[5];
+    double gathered[600];
+    double max, min, avg;
+    ListQuery query;
+    Data data;
+    unsigned long quantity_sum = 0;
+    for (unsigned int i = 0; i < 300; i++) {
+        static_price_object_construct(&static_objs[i], i, "static", (double)((i * 37) % 101));
+        dynamic_price_object_construct(&dynamic_objs[i], 10 + i, "dynamic", 50.0, -0.5);
+        nodes[2 * i].obj = &static_objs[i].obj;
+        nodes[2 * i + 1].obj = &dynamic_objs[i].obj;
+        quantity_sum += 10 + 2 * i;
+    }
+    for (unsigned int i = 0; i < 600; i++) {
+        nodes[i].next = (i + 1 < 600) ? &nodes[i + 1] : NULL;
+    }
+    list_query_init(&query, LIST_QUERY_COUNT | LIST_QUERY_PRICE_SUM);
+    list_query_run(&query, &head);
+    mu_assert("test_list_query: Testing empty list",
+              query.count == 0 && query.price_sum == 0 && query.price_max == 0);
+    head = &nodes[0];
+    data.ptr = (void*)gathered;
+    list_query_init(&query, LIST_QUERY_COUNT | LIST_QUERY_PRICE_MIN | LIST_QUERY_PRICE_MAX | LIST_QUERY_PRICE_SUM |
+                    LIST_QUERY_QUANTITY_SUM | LIST_QUERY_FOLD | LIST_QUERY_TOP);
+    list_query_set_fold(&query, gather, data);
+    list_query_set_top(&query, 5, top_objs, top_prices);
+    list_query_run(&query, &head);
+    max_min_avg_price(&head, &max, &min, &avg);
+    mu_assert("test_list_query: Testing count matches length",
+              query.count == (size_t)length(&head));
+    mu_assert("test_list_query: Testing min and max match max_min_avg_price",
+              query.price_min == min && query.price_max == max);
+    mu_assert("test_list_query: Testing sum matches max_min_avg_price",
+              relative_equal(query.price_sum / (double)query.count, avg));
+    mu_assert("test_list_query: Testing quantity sum",
+              query.quantity_sum == quantity_sum);
+    mu_assert("test_list_query: Testing fold visits every object in order",
+              query.fold_data.ptr == (void*)&gathered[600] && gathered[0] == object_price(&static_objs[0].obj) &&
+              gathered[1] == object_price(&dynamic_objs[0].obj) && gathered[598] == object_price(&static_objs[299].obj));
+    mu_assert("test_list_query: Testing top prices",
+              query.top_count == 5 && top_prices[0] == 100 && top_prices[2] == 100 && top_prices[3] == 99);
+    mu_assert("test_list_query: Testing ties keep list order",
+              top_objs[0] == &static_objs[30].obj && top_objs[1] == &static_objs[131].obj &&
+              top_objs[2] == &static_objs[232].obj);
+    list_query_init(&query, LIST_QUERY_COUNT | LIST_QUERY_QUANTITY_SUM);
+    list_query_run(&query, &head);
+    mu_assert("test_list_query: Testing unpriced query",
+              query.count == 600 && query.quantity_sum == quantity_sum && query.price_max == 0);
+    return NULL;
+}
+
+static Data sum_batch_prices(Object** objs, size_t n, Data data) {
+    double prices[FOREACH_BATCH_MAX];
+    object_price_batch(objs, n, prices);
+    for (size_t i = 0; i < n; i++) {
+        data.d += prices[i];
+    }
+    return data;
+}
+
+static Data gather_batch(Object** objs, size_t n, Data data) {
+    for (size_t i = 0; i < n; i++) {
+        data = gather(objs[i], data);
+    }
+    return data;
+}
+
+static Data count_batches(Object** objs, size_t n, Data data) {
+    data.l = (n == 7 || data.l < 0) ? data.l + 1 : -1000;
+    return data;
+}
+
+char* test_foreach_batch()
+{
+    StaticPriceObject static_objs[500];
+    DynamicPriceObject dynamic_objs[500];
+    LinkedListNode nodes[1000];
+    LinkedListNode* head = NULL;
+    double batch_price[1000];
+    double price[1000];
+    double sum = 0;
+    Data data;
+    for (unsigned int i = 0; i < 500; i++) {
+        static_price_object_construct(&static_objs[i], 1 + i, "static", 0.25 * i);
+        dynamic_price_object_construct(&dynamic_objs[i], 1 + i, "dynamic", 2.0, 0.5);
+        nodes[2 * i].obj = &static_objs[i].obj;
+        nodes[2 * i + 1].obj = &dynamic_objs[i].obj;
+    }
+    data.l = 0;
+    mu_assert("test_foreach_batch: Testing empty list",
+              foreach_batch(&head, count_batches, data, 7).l == 0);
+    for (unsigned int i = 0; i < 1000; i++) {
+        nodes[i].next = (i + 1 < 1000) ? &nodes[i + 1] : NULL;
+        sum += object_price(nodes[i].obj);
+    }
+    head = &nodes[0];
+    data.d = 0;
+    mu_assert("test_foreach_batch: Testing fold over batches",
+              approx_equal(foreach_batch(&head, sum_batch_prices, data, 0).d, sum));
+    data.ptr = (void*)batch_price;
+    mu_assert("test_foreach_batch: Testing objects are passed in order",
+              foreach_batch(&head, gather_batch, data, 33).ptr == (void*)&batch_price[1000]);
+    data.ptr = (void*)price;
+    foreach(&head, gather, data);
+    mu_assert("test_foreach_batch: Testing objects match foreach",
+              memcmp(batch_price, price, sizeof(price)) == 0);
+    head = &nodes[1000 - 7 * 4];
+    data.l = 0;
+    mu_assert("test_foreach_batch: Testing batch size",
+              foreach_batch(&head, count_batches, data, 7).l == 4);
+    return NULL;
+}
+
+static Data map_quantity(Object* obj) {
+    Data data;
+    data.l = obj->quantity;
+    return data;
+}
+
+static Data map_price(Object* obj) {
+    Data data;
+    data.d = object_price(obj);
+    return data;
+}
+
+static Data combine_long_sum(Data left, Data right) {
+    left.l += right.l;
+    return left;
+}
+
+static Data combine_double_sum(Data left, Data right) {
+    left.d += right.d;
+    return left;
+}
+
+static Data combine_max(Data left, Data right) {
+    return (right.d > left.d) ? right : left;
+}
+
+// Quotes 300 copies of obj in parallel from inside a parallel fold, which must not wait on the pool it runs on
+static Data map_nested_quote(Object* obj)
+{
+    Object* objs[300];
+    unsigned int quantities[300];
+    double out[300];
+    Data data;
+    data.d = 0;
+    for (size_t i = 0; i < 300; i++) {
+        objs[i] = obj;
+        quantities[i] = 1;
+    }
+    object_bulk_price_parallel(objs, quantities, 300, out, 4);
+    for (size_t i = 0; i < 300; i++) {
+        data.d += out[i];
+    }
+    return data;
+}
+
+char* test_foreach_parallel()
+{
+    static DynamicPriceObject objs[50000];
+    static LinkedListNode nodes[50000];
+    LinkedListNode* head = NULL;
+    Data identity, zero, result, first = {0};
+    long quantity_sum = 0;
+    double max_price = -INFINITY;
+    zero.d = 0;
+    identity.l = 0;
+    mu_assert("test_foreach_parallel: Testing empty list",
+              foreach_parallel(&head, map_quantity, combine_long_sum, identity, 4, false).l == 0);
+    for (unsigned int i = 0; i < 50000; i++) {
+        dynamic_price_object_construct(&objs[i], 1 + i % 97, "obj", 1e-3 * (1 + i % 1013), 0.5);
+        nodes[i].obj = &objs[i].obj;
+        nodes[i].next = (i + 1 < 50000) ? &nodes[i + 1] : NULL;
+        quantity_sum += 1 + i % 97;
+        max_price = fmax(max_price, object_price(&objs[i].obj));
+    }
+    head = &nodes[0];
+    for (unsigned int threads = 0; threads <= 5; threads++) {
+        mu_assert("test_foreach_parallel: Testing integer sum",
+                  foreach_parallel(&head, map_quantity, combine_long_sum, identity, threads, false).l == quantity_sum &&
+                  foreach_parallel(&head, map_quantity, combine_long_sum, identity, threads, true).l == quantity_sum);
+        identity.d = -INFINITY;
+        mu_assert("test_foreach_parallel: Testing max",
+                  foreach_parallel(&head, map_price, combine_max, identity, threads, false).d == max_price);
+        identity.l = 0;
+        result = foreach_parallel(&head, map_price, combine_double_sum, zero, threads, true);
+        if (threads == 0) {
+            first = result;
+        }
+        mu_assert("test_foreach_parallel: Testing deterministic sum is identical for any thread count",
+                  memcmp(&result.d, &first.d, sizeof(double)) == 0);
+        mu_assert("test_foreach_parallel: Testing sum matches the sequential fold",
+                  relative_equal(result.d, foreach_parallel(&head, map_price, combine_double_sum, zero, 1, false).d));
+    }
+
+    // A parallel quote issued from a pool task runs inline instead of deadlocking
+    double expected = 0;
+    nodes[99].next = NULL;
+    for (size_t i = 0; i < 100; i++) {
+        expected += 300 * object_bulk_price(&objs[i].obj, 1);
+    }
+    mu_assert("test_foreach_parallel: Testing nested parallel quote",
+              relative_equal(foreach_parallel(&head, map_nested_quote, combine_double_sum, zero, 4, true).d, expected));
+    return NULL;
+}
+
 char* test_length()
 {
     Object obj8;
@@ -566,6 +1237,403 @@ char* test_length()
     return NULL;
 }
 
+static Data sum_table_quantity(InventoryTable* table, size_t row, Data data) {
+    data.l += table->quantity[row];
+    return data;
+}
+
+char* test_unrolled_list()
+{
+    static StaticPriceObject objs[2000];
+    Object* model[2000];
+    UnrolledBlock* head = NULL;
+    UnrolledIterator iter;
+    LinkedListNode nodes[2000];
+    LinkedListNode* list = &nodes[0];
+    double max, min, avg, list_max, list_min, list_avg;
+    double price[2000];
+    Data data;
+    size_t n = 0;
+    unsigned int seed = 5150;
+    for (unsigned int i = 0; i < 2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        static_price_object_construct(&objs[i], (seed >> 16) % 100, "obj", (double)((seed >> 8) % 1000));
+    }
+    unrolled_iterator_begin(&iter, &head);
+    mu_assert("test_unrolled_list: Testing insert after at end",
+              unrolled_iterator_insert_after(&iter, &objs[0].obj) == ERR_INSERT_AFTER_END);
+    for (unsigned int i = 0; i < 1000; i++) {
+        mu_assert("test_unrolled_list: Testing append",
+                  unrolled_iterator_insert_before(&iter, &objs[i].obj) == 0);
+        model[n++] = &objs[i].obj;
+    }
+    // Insert after and before every third object and remove every fifth, mirroring the edits on an array
+    unrolled_iterator_begin(&iter, &head);
+    for (size_t pos = 0, i = 1000; !unrolled_iterator_at_end(&iter) && i < 2000; i++) {
+        mu_assert("test_unrolled_list: Testing iterator matches model",
+                  unrolled_iterator_get_object(&iter) == model[pos]);
+        if (i % 5 == 0) {
+            mu_assert("test_unrolled_list: Testing remove returns the object",
+                      unrolled_iterator_remove(&iter) == model[pos]);
+            memmove(&model[pos], &model[pos + 1], (n - pos - 1) * sizeof(Object*));
+            n--;
+        } else if (i % 3 == 0) {
+            unrolled_iterator_insert_after(&iter, &objs[i].obj);
+            memmove(&model[pos + 2], &model[pos + 1], (n - pos - 1) * sizeof(Object*));
+            model[pos + 1] = &objs[i].obj;
+            n++;
+        } else if (i % 3 == 1) {
+            unrolled_iterator_insert_before(&iter, &objs[i].obj);
+            memmove(&model[pos + 1], &model[pos], (n - pos) * sizeof(Object*));
+            model[pos++] = &objs[i].obj;
+            n++;
+            unrolled_iterator_next(&iter);
+            pos++;
+        } else {
+            unrolled_iterator_next(&iter);
+            pos++;
+        }
+    }
+    mu_assert("test_unrolled_list: Testing length",
+              unrolled_length(&head) == (int)n);
+    unrolled_iterator_begin(&iter, &head);
+    for (size_t i = 0; i < n; i++) {
+        mu_assert("test_unrolled_list: Testing list matches model",
+                  unrolled_iterator_get_object(&iter) == model[i]);
+        unrolled_iterator_next(&iter);
+    }
+    mu_assert("test_unrolled_list: Testing end of list",
+              unrolled_iterator_at_end(&iter) && unrolled_iterator_get_object(&iter) == NULL);
+
+    for (size_t i = 0; i < n; i++) {
+        nodes[i].obj = model[i];
+        nodes[i].next = (i + 1 < n) ? &nodes[i + 1] : NULL;
+    }
+    data.ptr = (void*)price;
+    mu_assert("test_unrolled_list: Testing foreach",
+              unrolled_foreach(&head, gather, data).ptr == (void*)&price[n] && price[n - 1] == object_price(model[n - 1]));
+    unrolled_max_min_avg_price(&head, &max, &min, &avg);
+    max_min_avg_price(&list, &list_max, &list_min, &list_avg);
+    mu_assert("test_unrolled_list: Testing max_min_avg_price",
+              max == list_max && min == list_min && relative_equal(avg, list_avg));
+    mu_assert("test_unrolled_list: Testing mergesort",
+              unrolled_mergesort(&head, compare_by_quantity) == 0);
+    mergesort(&list, compare_by_quantity);
+    unrolled_iterator_begin(&iter, &head);
+    for (LinkedListNode* node = list; node != NULL; node = node->next) {
+        mu_assert("test_unrolled_list: Testing mergesort matches list mergesort",
+                  unrolled_iterator_get_object(&iter) == node->obj);
+        unrolled_iterator_next(&iter);
+    }
+
+    // Removing everything frees every block
+    unrolled_iterator_begin(&iter, &head);
+    while (!unrolled_iterator_at_end(&iter)) {
+        unrolled_iterator_remove(&iter);
+    }
+    mu_assert("test_unrolled_list: Testing removing everything",
+              head == NULL && unrolled_length(&head) == 0);
+    unrolled_iterator_insert_before(&iter, &objs[0].obj);
+    unrolled_destroy(&head);
+    mu_assert("test_unrolled_list: Testing destroy",
+              head == NULL);
+    return NULL;
+}
+
+static unsigned int index_price_calls = 0;
+
+static double index_counted_price(void* obj) {
+    index_price_calls++;
+    return (double)((Object*)obj)->quantity;
+}
+
+char* test_price_index()
+{
+    static StaticPriceObject objs[5000];
+    static LinkedListNode nodes[5000];
+    PriceIndex index;
+    PriceRangeIterator range;
+    LinkedListNode* node;
+    Object* prev = NULL;
+    unsigned int seed = 8675309;
+    unsigned int in_range = 0;
+    unsigned int counted = 0;
+    price_index_init(&index);
+    mu_assert("test_price_index: Testing empty index",
+              price_index_find(&index, 1.0) == NULL && price_index_lower_bound(&index, 0) == NULL);
+    for (unsigned int i = 0; i < 5000; i++) {
+        seed = seed * 1103515245 + 12345;
+        static_price_object_construct(&objs[i], 1, "obj", (double)((seed >> 16) % 1000));
+        nodes[i].obj = &objs[i].obj;
+        price_index_insert(&index, &nodes[i]);
+    }
+    mu_assert("test_price_index: Testing list has every node",
+              length(&index.head) == 5000);
+    for (node = index.head; node != NULL; node = node->next) {
+        if (prev != NULL) {
+            mu_assert("test_price_index: Testing list is sorted by price",
+                      compare_by_price(prev, node->obj) <= 0);
+            mu_assert("test_price_index: Testing equal prices keep insertion order",
+                      compare_by_price(prev, node->obj) < 0 || prev < node->obj);
+        }
+        prev = node->obj;
+    }
+    for (unsigned int i = 0; i < 5000; i += 2) {
+        mu_assert("test_price_index: Testing remove",
+                  price_index_remove(&index, &nodes[i]));
+    }
+    mu_assert("test_price_index: Testing removing a missing node",
+              price_index_remove(&index, &nodes[0]) == false);
+    mu_assert("test_price_index: Testing length after removes",
+              length(&index.head) == 2500);
+    for (unsigned int i = 1; i < 5000; i += 2) {
+        Object* found = price_index_find(&index, object_price(&objs[i].obj));
+        mu_assert("test_price_index: Testing find",
+                  found != NULL && object_price(found) == object_price(&objs[i].obj));
+        if (object_price(&objs[i].obj) >= 250 && object_price(&objs[i].obj) <= 500) {
+            in_range++;
+        }
+    }
+    price_range_begin(&range, &index, 250, 500);
+    prev = NULL;
+    while (!price_range_at_end(&range)) {
+        Object* obj = price_range_get_object(&range);
+        mu_assert("test_price_index: Testing range is in order",
+                  object_price(obj) >= 250 && object_price(obj) <= 500 &&
+                  (prev == NULL || compare_by_price(prev, obj) <= 0));
+        prev = obj;
+        counted++;
+        price_range_next(&range);
+    }
+    mu_assert("test_price_index: Testing range has every object",
+              counted == in_range);
+    price_index_destroy(&index);
+
+    static Object counted_objs[1000];
+    price_index_init(&index);
+    for (unsigned int i = 0; i < 1000; i++) {
+        counted_objs[i].virtual_func_table.price = index_counted_price;
+        object_set_dispatch(&counted_objs[i], OBJECT_TYPE_OTHER);
+        counted_objs[i].quantity = (i * 7) % 100;
+        nodes[i].obj = &counted_objs[i];
+        mu_assert("test_price_index: Testing insert",
+                  price_index_insert(&index, &nodes[i]) == 0);
+    }
+    mu_assert("test_price_index: Testing insert prices only the inserted object",
+              index_price_calls == 1000);
+    index_price_calls = 0;
+    for (unsigned int i = 0; i < 100; i++) {
+        node = price_index_lower_bound(&index, (double)i);
+        mu_assert("test_price_index: Testing lower bound",
+                  node != NULL && node->obj->quantity == i);
+    }
+    mu_assert("test_price_index: Testing lookups use the cached prices",
+              index_price_calls == 0 && price_index_find(&index, 99.5) == NULL);
+    for (unsigned int i = 0; i < 1000; i += 3) {
+        mu_assert("test_price_index: Testing remove among equal prices",
+                  price_index_remove(&index, &nodes[i]));
+    }
+    mu_assert("test_price_index: Testing remove prices only the removed object",
+              index_price_calls == 334 && length(&index.head) == 666);
+    price_index_destroy(&index);
+    return NULL;
+}
+
+typedef struct {
+    Arena* arena;
+    unsigned int id;
+    LinkedListNode* head;
+    bool reused;
+} ArenaWorker;
+
+// Builds a list of 5000 nodes from its own cache, freeing and reallocating every other node along the way
+static void* arena_worker(void* arg)
+{
+    ArenaWorker* worker = arg;
+    ArenaCache cache;
+    LinkedListNode* node;
+    Object* obj;
+    arena_cache_init(&cache, worker->arena);
+    worker->head = NULL;
+    worker->reused = true;
+    for (unsigned int i = 0; i < 5000; i++) {
+        obj = &arena_new_static_price_object(&cache, 1, "static", worker->id)->obj;
+        node = arena_new_node(&cache, obj);
+        if (i % 2) {
+            arena_free(&cache, node, sizeof(LinkedListNode));
+            worker->reused = worker->reused && arena_new_node(&cache, obj) == node;
+        }
+        node->next = worker->head;
+        worker->head = node;
+    }
+    return NULL;
+}
+
+char* test_arena()
+{
+    Arena* arena;
+    ArenaCache cache;
+    LinkedListNode* head = NULL;
+    LinkedListNode* node;
+    LinkedListNode* freed;
+    DynamicPriceObject* dynamic_obj;
+    void* first = NULL;
+    double max, min, avg;
+    arena = arena_create(4096, false);
+    mu_assert("test_arena: Testing create",
+              arena != NULL);
+    arena_cache_init(&cache, arena);
+    mu_assert("test_arena: Testing oversized allocation",
+              arena_alloc(&cache, ARENA_CLASS_COUNT * ARENA_CLASS_SIZE + 1) == NULL &&
+              arena_alloc(&cache, 0) == NULL);
+    for (unsigned int i = 0; i < 10000; i++) {
+        Object* obj;
+        if (i % 2) {
+            obj = &arena_new_static_price_object(&cache, 1, "static", (double)(i % 100))->obj;
+        } else {
+            obj = &arena_new_dynamic_price_object(&cache, 1, "dynamic", 1.0, 0)->obj;
+        }
+        if (i == 0) {
+            first = obj;
+        }
+        node = arena_new_node(&cache, obj);
+        mu_assert("test_arena: Testing allocations are aligned",
+                  ((uintptr_t)node % ARENA_CLASS_SIZE) == 0 && ((uintptr_t)obj % ARENA_CLASS_SIZE) == 0);
+        node->next = head;
+        head = node;
+    }
+    max_min_avg_price(&head, &max, &min, &avg);
+    mu_assert("test_arena: Testing list built from the arena",
+              length(&head) == 10000 && max == 99 && min == 1);
+    mu_assert("test_arena: Testing slabs are cache-line aligned",
+              ((uintptr_t)first % 64) == 0);
+    freed = head;
+    head = head->next;
+    arena_free(&cache, freed, sizeof(LinkedListNode));
+    mu_assert("test_arena: Testing freed memory is reused",
+              arena_new_node(&cache, NULL) == freed);
+    arena_free(&cache, freed, 0);
+    arena_free(&cache, freed, ARENA_CLASS_COUNT * ARENA_CLASS_SIZE + 1);
+    mu_assert("test_arena: Testing frees of sizes that are never allocated are ignored",
+              arena_new_node(&cache, NULL) != freed);
+    arena_reset(arena);
+    dynamic_obj = arena_new_dynamic_price_object(&cache, 10, "dynamic", 2.0, 1);
+    mu_assert("test_arena: Testing allocation after reset",
+              dynamic_obj != NULL && approx_equal(object_price(&dynamic_obj->obj), 20.0));
+    mu_assert("test_arena: Testing reset keeps the slabs",
+              (void*)dynamic_obj == first);
+    arena_destroy(arena);
+    arena = arena_create(1, true);
+    mu_assert("test_arena: Testing huge page create",
+              arena != NULL);
+    arena_cache_init(&cache, arena);
+    for (size_t i = 0; i < (ARENA_HUGE_PAGE_SIZE - 64) / sizeof(LinkedListNode); i++) {
+        node = arena_new_node(&cache, NULL);
+        if (i == 0) {
+            first = node;
+        }
+    }
+    mu_assert("test_arena: Testing huge page slabs",
+              node != NULL && ((uintptr_t)first % ARENA_HUGE_PAGE_SIZE) == 64 &&
+              (char*)node - (char*)first == (ptrdiff_t)(ARENA_HUGE_PAGE_SIZE - 64 - sizeof(LinkedListNode)));
+    arena_destroy(arena);
+
+    // Threads allocating from one arena through their own caches never hand out the same memory twice
+    ArenaWorker workers[4];
+    pthread_t handles[4];
+    arena = arena_create(4096, false);
+    mu_assert("test_arena: Testing create",
+              arena != NULL);
+    for (unsigned int i = 0; i < 4; i++) {
+        workers[i].arena = arena;
+        workers[i].id = i;
+        mu_assert("test_arena: Testing worker thread starts",
+                  pthread_create(&handles[i], NULL, arena_worker, &workers[i]) == 0);
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+        max_min_avg_price(&workers[i].head, &max, &min, &avg);
+        mu_assert("test_arena: Testing each thread's list is intact",
+                  workers[i].reused && length(&workers[i].head) == 5000 && max == i && min == i);
+    }
+    arena_destroy(arena);
+    return NULL;
+}
+
+char* test_inventory_table()
+{
+    StaticPriceObject obj3;
+    DynamicPriceObject obj2;
+    StaticPriceObject obj1;
+    Object custom;
+    char name[] = "obj1";
+    LinkedListNode node3 = {&obj3.obj, NULL};
+    LinkedListNode node2 = {&obj2.obj, &node3};
+    LinkedListNode node1 = {&obj1.obj, &node2};
+    LinkedListNode custom_node = {&custom, NULL};
+    LinkedListNode* head = &node1;
+    LinkedListNode* custom_head = &custom_node;
+    LinkedListNode nodes[3];
+    InventoryRecord records[3];
+    LinkedListNode* exported = NULL;
+    InventoryTable table;
+    double max = 0;
+    double min = 0;
+    double avg = 0;
+    Data data;
+    static_price_object_construct(&obj1, 7, "obj1", 1.5);
+    dynamic_price_object_construct(&obj2, 4, "obj2", 7.0, -0.5);
+    static_price_object_construct(&obj3, 1, name, 1.0);
+    custom.virtual_func_table.price = custom_price;
+    object_set_dispatch(&custom, OBJECT_TYPE_OTHER);
+    inventory_table_init(&table);
+    mu_assert("test_inventory_table: Testing import succeeds",
+              inventory_table_import(&table, &head) == 0);
+    mu_assert("test_inventory_table: Testing table length is correct",
+              inventory_table_length(&table) == length(&head));
+    mu_assert("test_inventory_table: Testing equal names are interned once",
+              table.name_count == 2 && table.name_id[0] == table.name_id[2]);
+    mu_assert("test_inventory_table: Testing row price is correct",
+              inventory_table_price(&table, 1) == object_price(&obj2.obj));
+    inventory_table_max_min_avg_price(&table, &max, &min, &avg);
+    mu_assert("test_inventory_table: Testing max_min_avg_price max is correct",
+              approx_equal(max, 3.5));
+    mu_assert("test_inventory_table: Testing max_min_avg_price min is correct",
+              approx_equal(min, 1.0));
+    mu_assert("test_inventory_table: Testing max_min_avg_price avg is correct",
+              approx_equal(avg, 2.0));
+    data.l = 0;
+    mu_assert("test_inventory_table: Testing foreach fold",
+              inventory_table_foreach(&table, sum_table_quantity, data).l == 12);
+    mu_assert("test_inventory_table: Testing unsupported objects are rejected",
+              inventory_table_import(&table, &custom_head) == ERR_UNSUPPORTED_TYPE);
+    mu_assert("test_inventory_table: Testing remove of a missing row",
+              inventory_table_remove(&table, 3) == ERR_INVALID_ARGUMENT && inventory_table_length(&table) == 3);
+    mu_assert("test_inventory_table: Testing remove keeps the row order",
+              inventory_table_remove(&table, 0) == 0 &&
+              inventory_table_length(&table) == 2 && table.type[0] == OBJECT_TYPE_DYNAMIC);
+    inventory_table_export(&table, nodes, records, &exported);
+    mu_assert("test_inventory_table: Testing export list length",
+              length(&exported) == 2);
+    mu_assert("test_inventory_table: Testing exported dynamic object",
+              object_price(exported->obj) == object_price(&obj2.obj) &&
+              string_equal(object_name(exported->obj), "obj2") &&
+              approx_equal(object_bulk_price(exported->obj, 3), object_bulk_price(&obj2.obj, 3)));
+    mu_assert("test_inventory_table: Testing exported static object",
+              object_price(exported->next->obj) == 1.0 &&
+              object_quantity(exported->next->obj) == 1 &&
+              string_equal(object_name(exported->next->obj), "obj1"));
+    inventory_table_destroy(&table);
+    mu_assert("test_inventory_table: Testing destroyed table is empty",
+              inventory_table_length(&table) == 0);
+    inventory_table_export(&table, nodes, records, &exported);
+    mu_assert("test_inventory_table: Testing empty export",
+              exported == NULL);
+    return NULL;
+}
+
 static int merge_compare(Object* obj1, Object* obj2) {
     return (int)(((long)obj1) - ((long)obj2));
 }
@@ -853,6 +1921,559 @@ char* test_mergesort()
     return NULL;
 }
 
+static double now_seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+
+char* test_mergesort_stable()
+{
+    static StaticPriceObject objs[100000];
+    static LinkedListNode nodes[100000];
+    LinkedListNode* head = &nodes[0];
+    LinkedListIterator iter;
+    Object* prev = NULL;
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < 100000; i++) {
+        seed = seed * 1103515245 + 12345;
+        static_price_object_construct(&objs[i], (seed >> 16) % 1000, "obj", 1.0);
+        nodes[i].obj = &objs[i].obj;
+        nodes[i].next = (i + 1 < 100000) ? &nodes[i + 1] : NULL;
+    }
+    mergesort(&head, compare_by_quantity);
+    mu_assert("test_mergesort_stable: Testing sorted list has every node",
+              length(&head) == 100000);
+    iterator_begin(&iter, &head);
+    while (!iterator_at_end(&iter)) {
+        Object* obj = iterator_get_object(&iter);
+        if (prev != NULL) {
+            mu_assert("test_mergesort_stable: Testing list is sorted",
+                      prev->quantity <= obj->quantity);
+            mu_assert("test_mergesort_stable: Testing equal nodes keep their order",
+                      prev->quantity < obj->quantity || prev < obj);
+        }
+        prev = obj;
+        iterator_next(&iter);
+    }
+    head = NULL;
+    mergesort(&head, compare_by_quantity);
+    mu_assert("test_mergesort_stable: Testing empty list",
+              head == NULL);
+    return NULL;
+}
+
+static unsigned long compare_calls = 0;
+
+static int counted_compare_by_quantity(Object* obj1, Object* obj2) {
+    compare_calls++;
+    return compare_by_quantity(obj1, obj2);
+}
+
+char* test_mergesort_natural()
+{
+    static StaticPriceObject objs[20000];
+    static LinkedListNode nodes[20000];
+    static LinkedListNode expected_nodes[20000];
+    LinkedListNode* head = &nodes[0];
+    LinkedListNode* expected = &expected_nodes[0];
+    LinkedListNode* node;
+    LinkedListNode* expected_node;
+    unsigned int seed = 777;
+    for (unsigned int i = 0; i < 20000; i++) {
+        static_price_object_construct(&objs[i], i / 3, "obj", 1.0);
+        nodes[i].obj = &objs[i].obj;
+        nodes[i].next = (i + 1 < 20000) ? &nodes[i + 1] : NULL;
+    }
+    compare_calls = 0;
+    mergesort_natural(&head, counted_compare_by_quantity);
+    mu_assert("test_mergesort_natural: Testing sorted list costs n - 1 comparisons",
+              compare_calls == 19999 && head == &nodes[0] && nodes[19999].next == NULL);
+    for (unsigned int i = 0; i < 20000; i++) {
+        objs[i].obj.quantity = 20000 - i;
+    }
+    compare_calls = 0;
+    mergesort_natural(&head, counted_compare_by_quantity);
+    mu_assert("test_mergesort_natural: Testing descending list is reversed with n - 1 comparisons",
+              compare_calls == 19999 && head == &nodes[19999] && nodes[0].next == NULL);
+
+    // Nearly sorted and random lists with duplicates must match the stable mergesort exactly
+    for (unsigned int round = 0; round < 2; round++) {
+        for (unsigned int i = 0; i < 20000; i++) {
+            seed = seed * 1103515245 + 12345;
+            objs[i].obj.quantity = round ? (seed >> 16) % 500 : i + ((seed >> 16) % 100 == 0 ? 50 : 0);
+            nodes[i].next = (i + 1 < 20000) ? &nodes[i + 1] : NULL;
+            expected_nodes[i].obj = &objs[i].obj;
+            expected_nodes[i].next = (i + 1 < 20000) ? &expected_nodes[i + 1] : NULL;
+        }
+        head = &nodes[0];
+        expected = &expected_nodes[0];
+        mergesort(&expected, compare_by_quantity);
+        mergesort_natural(&head, compare_by_quantity);
+        for (node = head, expected_node = expected; expected_node != NULL;
+             node = node->next, expected_node = expected_node->next) {
+            mu_assert("test_mergesort_natural: Testing result matches mergesort",
+                      node != NULL && node->obj == expected_node->obj);
+        }
+        mu_assert("test_mergesort_natural: Testing result has no extra nodes",
+                  node == NULL);
+    }
+    return NULL;
+}
+
+char* test_mergesort_parallel()
+{
+    static DynamicPriceObject objs[30000];
+    static LinkedListNode nodes[30000];
+    static LinkedListNode expected_nodes[30000];
+    LinkedListNode* head;
+    LinkedListNode* expected = &expected_nodes[0];
+    LinkedListNode* node;
+    LinkedListNode* expected_node;
+    const double factors[] = {0, 0.5, 1, -0.5, 1.7};
+    unsigned int seed = 4242;
+    for (unsigned int i = 0; i < 30000; i++) {
+        seed = seed * 1103515245 + 12345;
+        dynamic_price_object_construct(&objs[i], 1 + (seed >> 16) % 40, "obj", (double)((seed >> 8) % 7), factors[i % 5]);
+        expected_nodes[i].obj = &objs[i].obj;
+        expected_nodes[i].next = (i + 1 < 30000) ? &expected_nodes[i + 1] : NULL;
+    }
+    mergesort(&expected, compare_by_price);
+    for (unsigned int threads = 0; threads <= 5; threads++) {
+        for (unsigned int i = 0; i < 30000; i++) {
+            nodes[i].obj = &objs[i].obj;
+            nodes[i].next = (i + 1 < 30000) ? &nodes[i + 1] : NULL;
+        }
+        head = &nodes[0];
+        mergesort_parallel(&head, compare_by_price, threads);
+        for (node = head, expected_node = expected; expected_node != NULL;
+             node = node->next, expected_node = expected_node->next) {
+            mu_assert("test_mergesort_parallel: Testing result matches mergesort",
+                      node != NULL && node->obj == expected_node->obj);
+        }
+        mu_assert("test_mergesort_parallel: Testing result has no extra nodes",
+                  node == NULL);
+    }
+    head = NULL;
+    mergesort_parallel(&head, compare_by_price, 4);
+    mu_assert("test_mergesort_parallel: Testing empty list",
+              head == NULL);
+    return NULL;
+}
+
+static unsigned int radix_key_calls = 0;
+
+static uint64_t counted_quantity_key(Object* obj) {
+    radix_key_calls++;
+    return object_quantity(obj);
+}
+
+char* test_radix_sort()
+{
+    static DynamicPriceObject objs[20000];
+    static LinkedListNode nodes[20000];
+    static LinkedListNode expected_nodes[20000];
+    LinkedListNode* head;
+    LinkedListNode* expected;
+    LinkedListNode* node;
+    LinkedListNode* expected_node;
+    unsigned int seed = 99;
+    mu_assert("test_radix_sort: Testing double keys keep their order",
+              double_sort_key(-INFINITY) < double_sort_key(-2.5) && double_sort_key(-2.5) < double_sort_key(-1e-300) &&
+              double_sort_key(-0.0) == double_sort_key(0.0) && double_sort_key(0.0) < double_sort_key(1e-300) &&
+              double_sort_key(1e-300) < double_sort_key(3.0) && double_sort_key(3.0) < double_sort_key(INFINITY));
+    for (unsigned int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;
+        dynamic_price_object_construct(&objs[i], (i % 3) ? (seed >> 16) % 300 : (seed >> 4), "obj",
+                                       (double)((seed >> 10) % 9) - 4, 0.5);
+    }
+    for (unsigned int pass = 0; pass < 2; pass++) {
+        for (unsigned int i = 0; i < 20000; i++) {
+            nodes[i].obj = &objs[i].obj;
+            nodes[i].next = (i + 1 < 20000) ? &nodes[i + 1] : NULL;
+            expected_nodes[i].obj = &objs[i].obj;
+            expected_nodes[i].next = (i + 1 < 20000) ? &expected_nodes[i + 1] : NULL;
+        }
+        head = &nodes[0];
+        expected = &expected_nodes[0];
+        if (pass == 0) {
+            radix_sort_by_quantity(&head);
+            mergesort(&expected, compare_by_quantity);
+        } else {
+            radix_sort_by_price(&head);
+            mergesort(&expected, compare_by_price);
+        }
+        for (node = head, expected_node = expected; expected_node != NULL;
+             node = node->next, expected_node = expected_node->next) {
+            mu_assert("test_radix_sort: Testing result matches mergesort",
+                      node != NULL && node->obj == expected_node->obj);
+        }
+        mu_assert("test_radix_sort: Testing result has no extra nodes",
+                  node == NULL);
+    }
+    for (unsigned int i = 0; i < 20000; i++) {
+        nodes[i].next = (i + 1 < 20000) ? &nodes[i + 1] : NULL;
+    }
+    head = &nodes[0];
+    radix_key_calls = 0;
+    mu_assert("test_radix_sort: Testing key sort succeeds",
+              radix_sort_by_key_u64(&head, counted_quantity_key) == 0);
+    mu_assert("test_radix_sort: Testing each key is computed once",
+              radix_key_calls == 20000 && length(&head) == 20000);
+    for (node = head; node->next != NULL; node = node->next) {
+        mu_assert("test_radix_sort: Testing key sort order",
+                  object_quantity(node->obj) <= object_quantity(node->next->obj));
+    }
+    head = NULL;
+    mu_assert("test_radix_sort: Testing empty list",
+              radix_sort_by_quantity(&head) == 0 && head == NULL);
+    return NULL;
+}
+
+char* test_mergesort_with_mode()
+{
+    static StaticPriceObject objs[5000];
+    static LinkedListNode nodes[5000];
+    static LinkedListNode expected_nodes[5000];
+    const SortMode modes[] = {SORT_MODE_AUTO, SORT_MODE_IN_PLACE, SORT_MODE_GATHER};
+    const unsigned int sizes[] = {5000, 100, 1};
+    LinkedListNode* head;
+    LinkedListNode* expected;
+    LinkedListNode* node;
+    LinkedListNode* expected_node;
+    unsigned int seed = 31337;
+    for (unsigned int i = 0; i < 5000; i++) {
+        seed = seed * 1103515245 + 12345;
+        static_price_object_construct(&objs[i], (seed >> 16) % 50, "obj", 1.0);
+    }
+    for (unsigned int size = 0; size < 3; size++) {
+        for (unsigned int mode = 0; mode < 3; mode++) {
+            unsigned int n = sizes[size];
+            for (unsigned int i = 0; i < n; i++) {
+                nodes[i].obj = &objs[i].obj;
+                nodes[i].next = (i + 1 < n) ? &nodes[i + 1] : NULL;
+                expected_nodes[i].obj = &objs[i].obj;
+                expected_nodes[i].next = (i + 1 < n) ? &expected_nodes[i + 1] : NULL;
+            }
+            head = &nodes[0];
+            expected = &expected_nodes[0];
+            mergesort(&expected, compare_by_quantity);
+            mergesort_with_mode(&head, compare_by_quantity, modes[mode]);
+            for (node = head, expected_node = expected; expected_node != NULL;
+                 node = node->next, expected_node = expected_node->next) {
+                mu_assert("test_mergesort_with_mode: Testing result matches mergesort",
+                          node != NULL && node->obj == expected_node->obj);
+            }
+            mu_assert("test_mergesort_with_mode: Testing result has no extra nodes",
+                      node == NULL);
+        }
+    }
+    head = NULL;
+    mergesort_with_mode(&head, compare_by_quantity, SORT_MODE_GATHER);
+    mu_assert("test_mergesort_with_mode: Testing empty list",
+              head == NULL);
+    return NULL;
+}
+
+// Price descending, then quantity ascending, then name ascending
+static int chained_compare(Object* obj1, Object* obj2) {
+    int result = -compare_by_price(obj1, obj2);
+    if (result == 0) {
+        result = compare_by_quantity(obj1, obj2);
+    }
+    if (result == 0) {
+        result = strcmp(object_name(obj1), object_name(obj2));
+    }
+    return result;
+}
+
+char* test_compare_composite()
+{
+    static const char* names[] = {"delta", "alpha", "charlie", "bravo"};
+    const SortKeySpec keys[] = {{SORT_KEY_PRICE, true}, {SORT_KEY_QUANTITY, false}, {SORT_KEY_NAME, false}};
+    static StaticPriceObject objs[3000];
+    static LinkedListNode nodes[3000];
+    static LinkedListNode merged_nodes[3000];
+    static LinkedListNode expected_nodes[3000];
+    CompositeComparator comparator;
+    LinkedListNode* head = &nodes[0];
+    LinkedListNode* merged = &merged_nodes[0];
+    LinkedListNode* expected = &expected_nodes[0];
+    LinkedListNode* node;
+    LinkedListNode* merged_node;
+    LinkedListNode* expected_node;
+    unsigned int seed = 2024;
+    mu_assert("test_compare_composite: Testing too many keys",
+              composite_comparator_init(&comparator, keys, COMPOSITE_KEY_MAX + 1) == ERR_UNSUPPORTED_TYPE);
+    mu_assert("test_compare_composite: Testing init",
+              composite_comparator_init(&comparator, keys, 3) == 0);
+    for (unsigned int i = 0; i < 3000; i++) {
+        seed = seed * 1103515245 + 12345;
+        static_price_object_construct(&objs[i], (seed >> 16) % 5, names[(seed >> 8) % 4], (double)((seed >> 20) % 4));
+        nodes[i].obj = &objs[i].obj;
+        nodes[i].next = (i + 1 < 3000) ? &nodes[i + 1] : NULL;
+        merged_nodes[i] = nodes[i];
+        merged_nodes[i].next = (i + 1 < 3000) ? &merged_nodes[i + 1] : NULL;
+        expected_nodes[i] = nodes[i];
+        expected_nodes[i].next = (i + 1 < 3000) ? &expected_nodes[i + 1] : NULL;
+    }
+    mergesort(&expected, chained_compare);
+    mergesort_composite(&head, &comparator);
+    composite_comparator_bind(&comparator);
+    mergesort(&merged, compare_composite);
+    composite_comparator_bind(NULL);
+    mu_assert("test_compare_composite: Testing unbound comparator",
+              compare_composite(&objs[0].obj, &objs[1].obj) == 0);
+    for (node = head, merged_node = merged, expected_node = expected; expected_node != NULL;
+         node = node->next, merged_node = merged_node->next, expected_node = expected_node->next) {
+        mu_assert("test_compare_composite: Testing decorated sort matches chained comparators",
+                  node != NULL && node->obj == expected_node->obj);
+        mu_assert("test_compare_composite: Testing bound comparator matches chained comparators",
+                  merged_node != NULL && merged_node->obj == expected_node->obj);
+    }
+    mu_assert("test_compare_composite: Testing result has no extra nodes",
+              node == NULL && merged_node == NULL);
+
+    // Worker threads of the parallel sort see the comparator bound by the caller
+    for (unsigned int threads = 2; threads <= 4; threads++) {
+        for (unsigned int i = 0; i < 3000; i++) {
+            merged_nodes[i].next = (i + 1 < 3000) ? &merged_nodes[i + 1] : NULL;
+        }
+        merged = &merged_nodes[0];
+        composite_comparator_bind(&comparator);
+        mergesort_parallel(&merged, compare_composite, threads);
+        composite_comparator_bind(NULL);
+        for (merged_node = merged, expected_node = expected; expected_node != NULL;
+             merged_node = merged_node->next, expected_node = expected_node->next) {
+            mu_assert("test_compare_composite: Testing parallel sort matches chained comparators",
+                      merged_node != NULL && merged_node->obj == expected_node->obj);
+        }
+        mu_assert("test_compare_composite: Testing parallel sort has no extra nodes",
+                  merged_node == NULL);
+    }
+    return NULL;
+}
+
+static unsigned int key_calls = 0;
+
+static double counted_price_key(Object* obj) {
+    key_calls++;
+    return object_price(obj);
+}
+
+static uint64_t quantity_key(Object* obj) {
+    return obj->quantity;
+}
+
+char* test_mergesort_by_key()
+{
+    StaticPriceObject static_objs[40];
+    DynamicPriceObject dynamic_objs[40];
+    LinkedListNode nodes[80];
+    LinkedListNode* head = NULL;
+    LinkedListIterator iter;
+    Object* prev = NULL;
+    bool stable = true;
+    for (unsigned int i = 0; i < 40; i++) {
+        static_price_object_construct(&static_objs[i], 1 + (i * 13) % 7, "static", (double)((i * 17) % 11) - 5);
+        dynamic_price_object_construct(&dynamic_objs[i], 1 + (i * 5) % 9, "dynamic", 3.0, 0.5);
+        nodes[2 * i].obj = &static_objs[i].obj;
+        nodes[2 * i + 1].obj = &dynamic_objs[i].obj;
+    }
+    for (unsigned int i = 0; i < 80; i++) {
+        nodes[i].next = (i + 1 < 80) ? &nodes[i + 1] : NULL;
+    }
+    mu_assert("test_mergesort_by_key: Testing empty list",
+              mergesort_by_key(&head, counted_price_key) == 0 && head == NULL && key_calls == 0);
+    head = &nodes[0];
+    mu_assert("test_mergesort_by_key: Testing price sort succeeds",
+              mergesort_by_key(&head, counted_price_key) == 0);
+    mu_assert("test_mergesort_by_key: Testing each key is computed once",
+              key_calls == 80 && length(&head) == 80);
+    iterator_begin(&iter, &head);
+    while (!iterator_at_end(&iter)) {
+        Object* obj = iterator_get_object(&iter);
+        if (prev != NULL) {
+            mu_assert("test_mergesort_by_key: Testing list is sorted by price",
+                      compare_by_price(prev, obj) <= 0);
+            if (compare_by_price(prev, obj) == 0 && prev > obj && object_type(prev) == object_type(obj)) {
+                stable = false;
+            }
+        }
+        prev = obj;
+        iterator_next(&iter);
+    }
+    mu_assert("test_mergesort_by_key: Testing price sort is stable",
+              stable);
+    mu_assert("test_mergesort_by_key: Testing quantity sort succeeds",
+              mergesort_by_key_u64(&head, quantity_key) == 0 && length(&head) == 80);
+    prev = NULL;
+    iterator_begin(&iter, &head);
+    while (!iterator_at_end(&iter)) {
+        Object* obj = iterator_get_object(&iter);
+        if (prev != NULL) {
+            mu_assert("test_mergesort_by_key: Testing list is sorted by quantity",
+                      prev->quantity <= obj->quantity);
+            if (prev->quantity == obj->quantity) {
+                mu_assert("test_mergesort_by_key: Testing quantity sort keeps price order",
+                          compare_by_price(prev, obj) <= 0);
+            }
+        }
+        prev = obj;
+        iterator_next(&iter);
+    }
+    return NULL;
+}
+
+char* bench_price_power()
+{
+    const size_t n = 1 << 20;
+    double* quantity = malloc(n * sizeof(double));
+    double* factor = malloc(n * sizeof(double));
+    double* out = malloc(n * sizeof(double));
+    double* expected = malloc(n * sizeof(double));
+    double start, pow_time, kernel_time;
+    double max_error = 0;
+    mu_assert("bench_price_power: Testing allocation",
+              quantity != NULL && factor != NULL && out != NULL && expected != NULL);
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        quantity[i] = (double)(1 + rand() % 10000);
+        factor[i] = -2.5 + 5.0 * rand() / RAND_MAX;
+    }
+    start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        expected[i] = pow(quantity[i], factor[i]);
+    }
+    pow_time = now_seconds() - start;
+    start = now_seconds();
+    price_power(quantity, factor, out, n);
+    kernel_time = now_seconds() - start;
+    for (size_t i = 0; i < n; i++) {
+        max_error = fmax(max_error, fabs(out[i] - expected[i]) / expected[i]);
+    }
+    printf("pow: %.2f ns/element, price_power: %.2f ns/element, max relative error: %g\n",
+           pow_time * 1e9 / (double)n, kernel_time * 1e9 / (double)n, max_error);
+    free(quantity);
+    free(factor);
+    free(out);
+    free(expected);
+    return NULL;
+}
+
+// Sums the prices of a list through object_price or through the function pointer table
+static double sum_prices(LinkedListNode* head, bool vtable) {
+    double sum = 0;
+    for (LinkedListNode* node = head; node != NULL; node = node->next) {
+        sum += vtable ? node->obj->virtual_func_table.price(node->obj) : object_price(node->obj);
+    }
+    return sum;
+}
+
+char* bench_dispatch()
+{
+    const size_t n = 10000000;
+    const size_t num_objs = 1 << 16;
+    StaticPriceObject* static_objs = malloc(num_objs * sizeof(StaticPriceObject));
+    DynamicPriceObject* dynamic_objs = malloc(num_objs * sizeof(DynamicPriceObject));
+    LinkedListNode* nodes = malloc(n * sizeof(LinkedListNode));
+    const char* layouts[] = {"homogeneous", "mixed"};
+    const double factors[] = {0, 0.5, 1, 2, -0.5};
+    double start, tagged_time, vtable_time, tagged_sum, vtable_sum;
+    mu_assert("bench_dispatch: Testing allocation",
+              static_objs != NULL && dynamic_objs != NULL && nodes != NULL);
+    for (size_t i = 0; i < num_objs; i++) {
+        static_price_object_construct(&static_objs[i], (unsigned int)(i % 100), "static", 1.0 + (double)(i % 7));
+        dynamic_price_object_construct(&dynamic_objs[i], (unsigned int)(i % 100), "dynamic", 0.5, factors[i % 5]);
+    }
+#ifdef POINTER_TAGGED_DISPATCH
+    printf("object_price dispatch: type tag\n");
+#else
+    printf("object_price dispatch: function pointer table\n");
+#endif
+    srand(1);
+    for (size_t layout = 0; layout < 2; layout++) {
+        for (size_t i = 0; i < n; i++) {
+            size_t obj = (size_t)rand() % num_objs;
+            nodes[i].obj = (layout == 1 && rand() % 2) ? &static_objs[obj].obj : &dynamic_objs[obj].obj;
+            nodes[i].next = (i + 1 < n) ? &nodes[i + 1] : NULL;
+        }
+        start = now_seconds();
+        tagged_sum = sum_prices(nodes, false);
+        tagged_time = now_seconds() - start;
+        start = now_seconds();
+        vtable_sum = sum_prices(nodes, true);
+        vtable_time = now_seconds() - start;
+        mu_assert("bench_dispatch: Testing both dispatch paths agree",
+                  tagged_sum == vtable_sum);
+        printf("%s: object_price %.2f ns/object, function pointer %.2f ns/object\n",
+               layouts[layout], tagged_time * 1e9 / (double)n, vtable_time * 1e9 / (double)n);
+    }
+    free(static_objs);
+    free(dynamic_objs);
+    free(nodes);
+    return NULL;
+}
+
+static Data count_quantity(Object* obj, Data data) {
+    data.l += obj->quantity;
+    return data;
+}
+
+char* bench_prefetch()
+{
+    const size_t n = 1 << 22;
+    const unsigned int distances[] = {0, 4, 8, 16, 32};
+    DynamicPriceObject* objs = malloc(n * sizeof(DynamicPriceObject));
+    LinkedListNode* nodes = malloc(n * sizeof(LinkedListNode));
+    size_t* order = malloc(n * sizeof(size_t));
+    LinkedListNode* head;
+    Data data;
+    double start, length_time, foreach_time, max_min_avg_time, max, min, avg;
+    mu_assert("bench_prefetch: Testing allocation",
+              objs != NULL && nodes != NULL && order != NULL);
+    // Link nodes and objects in shuffled heap order so every step misses the cache
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = (((size_t)rand() << 16) ^ (size_t)rand()) % (i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < n; i++) {
+        dynamic_price_object_construct(&objs[i], (unsigned int)(i % 100), "dynamic", 0.5, -0.5);
+        nodes[order[i]].obj = &objs[order[(i * 7919) % n]].obj;
+        nodes[order[i]].next = (i + 1 < n) ? &nodes[order[i + 1]] : NULL;
+    }
+    head = &nodes[order[0]];
+    for (size_t i = 0; i < sizeof(distances) / sizeof(distances[0]); i++) {
+        list_set_prefetch_distance(distances[i]);
+        start = now_seconds();
+        mu_assert("bench_prefetch: Testing length",
+                  length(&head) == (int)n);
+        length_time = now_seconds() - start;
+        start = now_seconds();
+        data.l = 0;
+        data = foreach(&head, count_quantity, data);
+        foreach_time = now_seconds() - start;
+        start = now_seconds();
+        max_min_avg_price(&head, &max, &min, &avg);
+        max_min_avg_time = now_seconds() - start;
+        printf("distance %2u: length %.2f ns/node, foreach %.2f ns/node, max_min_avg_price %.2f ns/node\n",
+               distances[i], length_time * 1e9 / (double)n, foreach_time * 1e9 / (double)n,
+               max_min_avg_time * 1e9 / (double)n);
+    }
+    list_set_prefetch_distance(16);
+    free(objs);
+    free(nodes);
+    free(order);
+    return NULL;
+}
+
 typedef char* (*test_fn_t)();
 typedef struct {
     char* name;
@@ -862,21 +2483,51 @@ typedef struct {
 test_t tests[] = {{"test_static_price_object", test_static_price_object},
                   {"test_dynamic_price_object", test_dynamic_price_object},
                   {"test_polymorphism", test_polymorphism},
+                  {"test_object_price_batch", test_object_price_batch},
                   {"test_compare_by_quantity", test_compare_by_quantity},
                   {"test_compare_by_price", test_compare_by_price},
                   {"test_static_bulk_price", test_static_bulk_price},
                   {"test_dynamic_bulk_price", test_dynamic_bulk_price},
+                  {"test_dynamic_bulk_price_large", test_dynamic_bulk_price_large},
+                  {"test_dynamic_price_memo", test_dynamic_price_memo},
+                  {"test_dynamic_price_specialized", test_dynamic_price_specialized},
+                  {"test_price_power", test_price_power},
+                  {"test_bulk_price_parallel", test_bulk_price_parallel},
+                  {"test_price_curve", test_price_curve},
                   {"test_iterator_basic", test_iterator_basic},
                   {"test_iterator_remove", test_iterator_remove},
+                  {"test_iterator_prefetch", test_iterator_prefetch},
                   {"test_iterator_insert", test_iterator_insert},
                   {"test_max_min_avg_price", test_max_min_avg_price},
+                  {"test_max_min_avg_price_parallel", test_max_min_avg_price_parallel},
+                  {"test_price_aggregate", test_price_aggregate},
                   {"test_foreach", test_foreach},
+                  {"test_foreach_batch", test_foreach_batch},
+                  {"test_foreach_parallel", test_foreach_parallel},
                   {"test_length", test_length},
+                  {"test_list_query", test_list_query},
+                  {"test_unrolled_list", test_unrolled_list},
+                  {"test_price_index", test_price_index},
+                  {"test_arena", test_arena},
+                  {"test_inventory_table", test_inventory_table},
                   {"test_merge", test_merge},
                   {"test_split", test_split},
-                  {"test_mergesort", test_mergesort}};
+                  {"test_mergesort", test_mergesort},
+                  {"test_mergesort_stable", test_mergesort_stable},
+                  {"test_mergesort_natural", test_mergesort_natural},
+                  {"test_mergesort_parallel", test_mergesort_parallel},
+                  {"test_mergesort_with_mode", test_mergesort_with_mode},
+                  {"test_compare_composite", test_compare_composite},
+                  {"test_mergesort_by_key", test_mergesort_by_key},
+                  {"test_radix_sort", test_radix_sort}};
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
 
+// Benchmarks only run when named on the command line
+test_t benchmarks[] = {{"bench_price_power", bench_price_power},
+                       {"bench_dispatch", bench_dispatch},
+                       {"bench_prefetch", bench_prefetch}};
+size_t num_benchmarks = sizeof(benchmarks)/sizeof(benchmarks[0]);
+
 char* single_test(test_fn_t test, size_t iters) {
     for (size_t i = 0; i < iters; i++) {
         mu_run_test(test);
@@ -922,6 +2573,12 @@ int main(int argc, char** argv) {
             break;
         }
     }
+    for (size_t i = 0; i < num_benchmarks; i++) {
+        if (string_equal(argv[1], benchmarks[i].name)) {
+            result = single_test(benchmarks[i].test, iters);
+            break;
+        }
+    }
     if (result) {
         printf("%s\n", result);
     }